@@ -0,0 +1,345 @@
+#include "AppConfig.h"
+#include <iostream>
+#include <string>
+#include <cstdlib>
+
+// Reads the value following argv[i] as an integer, advancing i
+static bool ReadIntArgument(int argc, char** argv, int& i, int& value) {
+    if (i + 1 >= argc) {
+        std::cerr << "Missing value for " << argv[i] << std::endl;
+        return false;
+    }
+    char* end = nullptr;
+    long parsed = std::strtol(argv[++i], &end, 10);
+    if (*end != '\0' || parsed < 0) {
+        std::cerr << "Invalid value for " << argv[i - 1] << ": " << argv[i] << std::endl;
+        return false;
+    }
+    value = static_cast<int>(parsed);
+    return true;
+}
+
+// Reads the value following argv[i] as a float, advancing i
+static bool ReadFloatArgument(int argc, char** argv, int& i, float& value) {
+    if (i + 1 >= argc) {
+        std::cerr << "Missing value for " << argv[i] << std::endl;
+        return false;
+    }
+    char* end = nullptr;
+    float parsed = std::strtof(argv[++i], &end);
+    if (*end != '\0' || parsed < 0.0f) {
+        std::cerr << "Invalid value for " << argv[i - 1] << ": " << argv[i] << std::endl;
+        return false;
+    }
+    value = parsed;
+    return true;
+}
+
+bool ParseCommandLine(int argc, char** argv, AppConfig& config) {
+    bool framesGiven = false;
+    bool warmupGiven = false;
+    bool deltaTimeGiven = false;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool ok = true;
+
+        if (arg == "--headless") {
+            config.headless = true;
+        }
+        else if (arg == "--no-vsync") {
+            config.vsync = false;
+        }
+        else if (arg == "--frames") {
+            ok = ReadIntArgument(argc, argv, i, config.benchmarkFrames);
+            framesGiven = true;
+        }
+        else if (arg == "--warmup") {
+            ok = ReadIntArgument(argc, argv, i, config.warmupFrames);
+            warmupGiven = true;
+        }
+        else if (arg == "--dt") {
+            ok = ReadFloatArgument(argc, argv, i, config.fixedDeltaTime);
+            deltaTimeGiven = true;
+        }
+        else if (arg == "--particles") {
+            ok = ReadIntArgument(argc, argv, i, config.particleCount);
+        }
+        else if (arg == "--local-size") {
+            ok = ReadIntArgument(argc, argv, i, config.localSize);
+        }
+        else if (arg == "--ping-pong") {
+            config.pingPong = true;
+        }
+        else if (arg == "--layout") {
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value for " << arg << std::endl;
+                ok = false;
+            }
+            else {
+                std::string layout = argv[++i];
+                if (layout == "aos") config.particleLayout = ParticleLayout::AoS;
+                else if (layout == "soa") config.particleLayout = ParticleLayout::SoA;
+                else if (layout == "packed") config.particleLayout = ParticleLayout::Packed;
+                else {
+                    std::cerr << "Invalid value for " << arg << ": " << layout << std::endl;
+                    ok = false;
+                }
+            }
+        }
+        else if (arg == "--step") {
+            ok = ReadFloatArgument(argc, argv, i, config.simulationStep);
+        }
+        else if (arg == "--max-substeps") {
+            ok = ReadIntArgument(argc, argv, i, config.maxSubsteps);
+        }
+        else if (arg == "--integrator") {
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value for " << arg << std::endl;
+                ok = false;
+            }
+            else {
+                std::string integrator = argv[++i];
+                if (integrator == "euler") config.integrator = ParticleIntegrator::ExplicitEuler;
+                else if (integrator == "semi-implicit") config.integrator = ParticleIntegrator::SemiImplicitEuler;
+                else if (integrator == "verlet") config.integrator = ParticleIntegrator::VelocityVerlet;
+                else {
+                    std::cerr << "Invalid value for " << arg << ": " << integrator << std::endl;
+                    ok = false;
+                }
+            }
+        }
+        else if (arg == "--gravity") {
+            ok = ReadFloatArgument(argc, argv, i, config.gravity);
+        }
+        else if (arg == "--curl-noise") {
+            ok = ReadFloatArgument(argc, argv, i, config.curlNoise);
+        }
+        else if (arg == "--curl-scale") {
+            ok = ReadFloatArgument(argc, argv, i, config.curlScale);
+        }
+        else if (arg == "--curl-period") {
+            ok = ReadFloatArgument(argc, argv, i, config.curlPeriod);
+        }
+        else if (arg == "--curl-resolution") {
+            ok = ReadIntArgument(argc, argv, i, config.curlResolution);
+        }
+        else if (arg == "--field-cache") {
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value for " << arg << std::endl;
+                ok = false;
+            }
+            else {
+                config.fieldCacheDirectory = argv[++i];
+            }
+        }
+        else if (arg == "--no-field-cache") {
+            config.fieldCacheDirectory.clear();
+        }
+        else if (arg == "--backend") {
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value for " << arg << std::endl;
+                ok = false;
+            }
+            else {
+                std::string backend = argv[++i];
+                if (backend == "gpu") config.backend = SimulationBackend::Gpu;
+                else if (backend == "cpu") config.backend = SimulationBackend::Cpu;
+                else {
+                    std::cerr << "Invalid value for " << arg << ": " << backend << std::endl;
+                    ok = false;
+                }
+            }
+        }
+        else if (arg == "--threads") {
+            ok = ReadIntArgument(argc, argv, i, config.cpuThreads);
+        }
+        else if (arg == "--print-graph") {
+            config.printFrameGraph = true;
+        }
+        else if (arg == "--inspect") {
+            ok = ReadIntArgument(argc, argv, i, config.inspectCount);
+        }
+        else if (arg == "--inspect-stride") {
+            ok = ReadIntArgument(argc, argv, i, config.inspectStride);
+        }
+        else if (arg == "--inspect-every") {
+            ok = ReadIntArgument(argc, argv, i, config.inspectInterval);
+        }
+        else if (arg == "--inspect-latency") {
+            ok = ReadIntArgument(argc, argv, i, config.inspectLatency);
+        }
+        else if (arg == "--emit-rate") {
+            ok = ReadFloatArgument(argc, argv, i, config.emitRate);
+        }
+        else if (arg == "--emitters") {
+            ok = ReadIntArgument(argc, argv, i, config.emitterCount);
+        }
+        else if (arg == "--sort") {
+            config.sortParticles = true;
+        }
+        else if (arg == "--sort-bench") {
+            ok = ReadIntArgument(argc, argv, i, config.sortBenchmarkKeys);
+        }
+        else if (arg == "--shader-cache") {
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value for " << arg << std::endl;
+                ok = false;
+            }
+            else {
+                config.shaderCacheDirectory = argv[++i];
+            }
+        }
+        else if (arg == "--no-shader-cache") {
+            config.shaderCacheDirectory.clear();
+        }
+        else if (arg == "--hot-reload") {
+            config.hotReload = true;
+        }
+        else if (arg == "--shaders-from-disk") {
+            config.shadersFromDisk = true;
+        }
+        else if (arg == "--gpu-profile") {
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value for " << arg << std::endl;
+                ok = false;
+            }
+            else {
+                config.gpuProfilePath = argv[++i];
+            }
+        }
+        else if (arg == "--cpu-profile") {
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value for " << arg << std::endl;
+                ok = false;
+            }
+            else {
+                config.cpuProfilePath = argv[++i];
+            }
+        }
+        else if (arg == "--cpu-start") {
+            ok = ReadIntArgument(argc, argv, i, config.cpuProfileStart);
+        }
+        else if (arg == "--cpu-frames") {
+            ok = ReadIntArgument(argc, argv, i, config.cpuProfileFrames);
+        }
+        else if (arg == "--seed") {
+            ok = ReadIntArgument(argc, argv, i, config.seed);
+        }
+        else if (arg == "--validate") {
+            ok = ReadIntArgument(argc, argv, i, config.validateFrames);
+        }
+        else if (arg == "--width") {
+            ok = ReadIntArgument(argc, argv, i, config.windowWidth);
+        }
+        else if (arg == "--height") {
+            ok = ReadIntArgument(argc, argv, i, config.windowHeight);
+        }
+        else {
+            std::cerr << "Unknown argument: " << arg << std::endl;
+            ok = false;
+        }
+
+        if (!ok) {
+            return false;
+        }
+    }
+
+    if (config.windowWidth <= 0 || config.windowHeight <= 0) {
+        std::cerr << "Window size must be positive" << std::endl;
+        return false;
+    }
+    if (config.particleCount <= 0 || config.localSize <= 0) {
+        std::cerr << "Particle count and local size must be positive" << std::endl;
+        return false;
+    }
+    if (config.emitterCount < 0) {
+        std::cerr << "--emitters must not be negative" << std::endl;
+        return false;
+    }
+    if (config.curlResolution <= 1) {
+        std::cerr << "--curl-resolution must be at least 2" << std::endl;
+        return false;
+    }
+    if (config.maxSubsteps <= 0) {
+        std::cerr << "--max-substeps must be positive" << std::endl;
+        return false;
+    }
+
+    if (config.validateFrames > 0 && config.backend != SimulationBackend::Gpu) {
+        std::cerr << "--validate checks the compute shader, it needs the gpu backend" << std::endl;
+        return false;
+    }
+
+    if (config.emitRate > 0.0f && (config.backend != SimulationBackend::Gpu || config.validateFrames > 0)) {
+        std::cerr << "--emit-rate runs the pooled simulation on the GPU, it needs the gpu backend and no --validate" << std::endl;
+        return false;
+    }
+
+    if (config.curlNoise > 0.0f && (config.backend != SimulationBackend::Gpu || config.validateFrames > 0)) {
+        std::cerr << "--curl-noise samples a texture in the compute shader, it needs the gpu backend and no --validate" << std::endl;
+        return false;
+    }
+
+    // Headless runs are benchmarks: fixed frame count, fixed time step and no vsync so numbers are repeatable
+    if (config.headless) {
+        config.vsync = false;
+        if (!framesGiven) config.benchmarkFrames = 1000;
+        if (!warmupGiven) config.warmupFrames = 10;
+        if (!deltaTimeGiven) config.fixedDeltaTime = 1.0f / 60.0f;
+    }
+
+    // A validation run is its own fixed-length run with fixed inputs, not a benchmark
+    if (config.validateFrames > 0) {
+        config.benchmarkFrames = 0;
+        config.warmupFrames = 0;
+    }
+
+    return true;
+}
+
+void PrintUsage(const char* programName) {
+    std::cerr << "Usage: " << programName << " [options]\n"
+        << "  --headless            Render offscreen behind a hidden window and print a benchmark report\n"
+        << "  --frames N            Number of measured frames before exiting (default 1000 when headless)\n"
+        << "  --warmup N            Frames to run before measuring (default 10 when headless)\n"
+        << "  --dt SECONDS          Fixed frame time fed to the simulation (default 1/60 when headless, wall clock otherwise)\n"
+        << "  --step SECONDS        Fixed simulation step, a frame runs as many as its time covers (default 1/120, 0 = one step per frame)\n"
+        << "  --max-substeps N      Most simulation steps per frame, a longer frame drops the rest of its time (default 8)\n"
+        << "  --integrator I        euler, semi-implicit or verlet, the shader variant advancing the particles (default euler)\n"
+        << "  --gravity G           Downward acceleration in NDC units per second squared (default 0)\n"
+        << "  --curl-noise S        Curl-noise force field of strength S in NDC units per second squared, baked on the CPU (default 0)\n"
+        << "  --curl-scale F        Noise features across the field (default 2)\n"
+        << "  --curl-period T       Simulated seconds between two baked time slices of the field (default 2, 0 = frozen), the field repeats after 64 slices\n"
+        << "  --curl-resolution N   Texels along each side of the field (default 128)\n"
+        << "  --field-cache DIR     Directory of the baked field slices (default field_cache)\n"
+        << "  --no-field-cache      Always bake the field\n"
+        << "  --no-vsync            Disable vsync (always off when headless)\n"
+        << "  --particles N         Number of particles (default 1000)\n"
+        << "  --local-size N        Compute work group size, clamped to the device limit (default 256)\n"
+        << "  --ping-pong           Double-buffer the particle state, compute reads one buffer and writes the other\n"
+        << "  --layout L            Particle memory layout: aos (48-byte records), soa (one buffer per field) or packed (20-byte records) (default aos)\n"
+        << "  --backend B           Run the particle update in the compute shader or on the CPU, B is gpu or cpu (default gpu)\n"
+        << "  --threads N           Threads of the CPU backend (default one per hardware thread)\n"
+        << "  --print-graph         Print the memory barriers the frame graph inserts\n"
+        << "  --inspect N           Print N sampled particles read back asynchronously (default off)\n"
+        << "  --inspect-stride S    Sample every S-th particle (default 1)\n"
+        << "  --inspect-every K     Capture a sample every K frames (default 1)\n"
+        << "  --inspect-latency L   Only print captures at least L frames old (default 3)\n"
+        << "  --emit-rate R         Pool the particles on GPU alive/dead lists and emit R per second (default off, every particle respawns on death)\n"
+        << "  --emitters N          N emitters in a GPU table updated by the one dispatch, the first one follows the mouse (default off)\n"
+        << "  --sort                Draw back to front, oldest particles first, sorted on the GPU every frame\n"
+        << "  --sort-bench N        Benchmark the GPU radix sort on N random keys against the CPU reference, then exit\n"
+        << "  --shader-cache DIR    Directory of the program binary cache (default shader_cache)\n"
+        << "  --no-shader-cache     Always compile shaders from source\n"
+        << "  --hot-reload          Watch the shader files and swap in rebuilt programs without restarting\n"
+        << "  --shaders-from-disk   Read the .glsl files instead of the copies embedded in release builds\n"
+        << "  --gpu-profile PATH    Time every pass on the GPU, write PATH.csv and a Chrome trace to PATH.json\n"
+        << "  --cpu-profile PATH    Capture the CPU zones of a window of frames as a Chrome trace in PATH.json (F9 captures on demand)\n"
+        << "  --cpu-start N         First frame of the CPU capture, 0 includes the startup (default 0)\n"
+        << "  --cpu-frames N        Frames per CPU capture (default 120)\n"
+        << "  --seed N              Seed of the particle RNG (default 1)\n"
+        << "  --validate N          Check N frames of the compute shader against the CPU reference with fixed inputs\n"
+        << "  --width N             Window / offscreen target width (default 640)\n"
+        << "  --height N            Window / offscreen target height (default 480)" << std::endl;
+}
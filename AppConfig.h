@@ -0,0 +1,57 @@
+#pragma once
+#include <string>
+#include "Particle.h"
+
+// Where the particle update runs
+enum class SimulationBackend {
+    Gpu, // compute_shader.glsl
+    Cpu, // CpuSimulation, for machines without usable compute shaders
+};
+
+// Runtime settings, filled from the command line
+struct AppConfig {
+    int windowWidth = 640;        // Width of the window (or of the offscreen target when headless)
+    int windowHeight = 480;       // Height of the window (or of the offscreen target when headless)
+    int particleCount = 1000;     // Number of particles
+    int localSize = 256;          // Compute shader local_size_x, injected into compute_shader.glsl
+    bool pingPong = false;        // Double-buffer the particle state so compute and draw can overlap
+    ParticleLayout particleLayout = ParticleLayout::AoS; // GPU memory layout of the particle state
+    SimulationBackend backend = SimulationBackend::Gpu; // Where the particle update runs
+    int cpuThreads = 0;           // Threads of the CPU backend (0 = one per hardware thread)
+    bool headless = false;        // Render into an offscreen FBO behind a hidden window
+    bool vsync = true;            // Wait for vertical blank when swapping buffers
+    int benchmarkFrames = 0;      // Number of measured frames before exiting (0 = run until the window closes)
+    int warmupFrames = 0;         // Frames run before measuring starts
+    float fixedDeltaTime = 0.0f;  // Frame time fed to the simulation in seconds (0 = use the wall clock)
+    float simulationStep = 1.0f / 120.0f; // Fixed simulation step in seconds (0 = one step per frame, as long as the frame)
+    int maxSubsteps = 8;          // Most steps simulated in one frame, longer frames drop the rest of their time
+    ParticleIntegrator integrator = ParticleIntegrator::ExplicitEuler; // Shader variant advancing position and velocity
+    float gravity = 0.0f;         // Downward acceleration in NDC units per second squared (0 = velocities never change)
+    float curlNoise = 0.0f;       // Strength of the baked curl-noise force field in NDC units per second squared (0 = off)
+    float curlScale = 2.0f;       // Noise features across the field
+    float curlPeriod = 2.0f;      // Simulated seconds between two baked time slices of the field (0 = the field never changes)
+    int curlResolution = 128;     // Texels along each side of a baked slice
+    std::string fieldCacheDirectory = "field_cache"; // Where baked field slices are cached (empty = always bake)
+    bool printFrameGraph = false; // Print the barriers the frame graph inserts in the first frames
+    int inspectCount = 0;         // Particles read back by the debug inspector (0 = inspector off)
+    int inspectStride = 1;        // Sample every n-th particle
+    int inspectInterval = 1;      // Frames between two inspector captures
+    int inspectLatency = 3;       // Minimum age in frames of a capture before it is printed
+    int validateFrames = 0;       // Frames checked against the CPU reference (0 = no validation)
+    float emitRate = 0.0f;        // Particles emitted per second from a pool with GPU alive/dead lists (0 = every slot respawns on death)
+    int emitterCount = 0;         // Emitters in a GPU table, each particle belongs to one (0 = a single emitter at the mouse)
+    bool sortParticles = false;   // Draw back to front, ordered by a GPU radix sort every frame
+    int sortBenchmarkKeys = 0;    // Run the radix sort microbenchmark on this many keys instead of the particle system (0 = off)
+    std::string shaderCacheDirectory = "shader_cache"; // Where linked program binaries are cached (empty = no cache)
+    bool hotReload = false;       // Rebuild shader programs in the background when their files change
+    bool shadersFromDisk = false; // Read the .glsl files even when the build embedded them (implied by hotReload)
+    std::string gpuProfilePath;   // Writes per-pass GPU timings to <path>.csv and <path>.json (empty = off)
+    std::string cpuProfilePath;   // Writes a Chrome trace of the CPU zones to <path>.json (empty = only on F9, to cpu_profile.json)
+    int cpuProfileStart = 0;      // First captured frame, 0 includes the startup
+    int cpuProfileFrames = 120;   // Frames per CPU capture
+    int seed = 1;                 // Seed of the particle RNG, the same seed reproduces the same run
+};
+
+// Parses argv into config, returns false on unknown or malformed arguments
+bool ParseCommandLine(int argc, char** argv, AppConfig& config);
+void PrintUsage(const char* programName);
@@ -0,0 +1,53 @@
+#include "Benchmark.h"
+#include <algorithm>
+#include <cmath>
+
+double Percentile(const std::vector<double>& sorted, double percent) {
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    size_t rank = static_cast<size_t>(std::ceil(percent / 100.0 * sorted.size()));
+    rank = std::max<size_t>(rank, 1);
+    return sorted[std::min(rank, sorted.size()) - 1];
+}
+
+void BenchmarkStats::Reserve(size_t frameCount) {
+    frameTimes.reserve(frameCount);
+}
+
+void BenchmarkStats::AddFrame(double frameTime, double simTime, double renderTime) {
+    frameTimes.push_back(frameTime);
+    totalSimTime += simTime;
+    totalRenderTime += renderTime;
+}
+
+void BenchmarkStats::Report(std::ostream& out, size_t particleCount, const char* renderer, const std::string& backend) const {
+    std::vector<double> sorted = frameTimes;
+    std::sort(sorted.begin(), sorted.end());
+
+    double totalFrameTime = 0.0;
+    for (double t : frameTimes) {
+        totalFrameTime += t;
+    }
+
+    size_t frames = frameTimes.size();
+    double particlesPerSecond = totalSimTime > 0.0 ? double(particleCount) * frames / totalSimTime : 0.0;
+    double nsPerParticle = particleCount > 0 && frames > 0 ? totalSimTime * 1e9 / (double(particleCount) * frames) : 0.0;
+    double framesPerSecond = totalFrameTime > 0.0 ? frames / totalFrameTime : 0.0;
+
+    // One "key: value" per line so automation can grep the numbers
+    out << "=== Benchmark ===\n"
+        << "renderer: " << (renderer ? renderer : "unknown") << "\n"
+        << "backend: " << backend << "\n"
+        << "particles: " << particleCount << "\n"
+        << "frames: " << frames << "\n"
+        << "fps: " << framesPerSecond << "\n"
+        << "particles_per_sec: " << particlesPerSecond << "\n"
+        << "sim_ns_per_particle: " << nsPerParticle << "\n"
+        << "frame_ms_p50: " << Percentile(sorted, 50.0) * 1000.0 << "\n"
+        << "frame_ms_p95: " << Percentile(sorted, 95.0) * 1000.0 << "\n"
+        << "frame_ms_p99: " << Percentile(sorted, 99.0) * 1000.0 << "\n"
+        << "total_frame_s: " << totalFrameTime << "\n"
+        << "total_sim_s: " << totalSimTime << "\n"
+        << "total_render_s: " << totalRenderTime << std::endl;
+}
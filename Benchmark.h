@@ -0,0 +1,27 @@
+#pragma once
+#include <vector>
+#include <ostream>
+#include <cstddef>
+#include <string>
+
+// Nearest-rank percentile of an already sorted list
+double Percentile(const std::vector<double>& sorted, double percent);
+
+// Collects per-frame timings of a benchmark run and prints a summary at exit
+class BenchmarkStats {
+public:
+    void Reserve(size_t frameCount);
+
+    // All times in seconds
+    void AddFrame(double frameTime, double simTime, double renderTime);
+
+    size_t FrameCount() const { return frameTimes.size(); }
+
+    // Prints particles/sec, ns per simulated particle, frame time percentiles and total sim/render time
+    void Report(std::ostream& out, size_t particleCount, const char* renderer, const std::string& backend) const;
+
+private:
+    std::vector<double> frameTimes;
+    double totalSimTime = 0.0;
+    double totalRenderTime = 0.0;
+};
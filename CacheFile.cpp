@@ -0,0 +1,60 @@
+#include "CacheFile.h"
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <thread>
+#include <sys/stat.h>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <direct.h>
+#include <windows.h>
+#endif
+
+uint64_t Fnv1a(const std::string& data, uint64_t hash) {
+    for (unsigned char c : data) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+std::string HashHex(uint64_t hash) {
+    char hex[17];
+    std::snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(hash));
+    return hex;
+}
+
+bool MakeCacheDirectory(const std::string& directory) {
+#ifdef _WIN32
+    _mkdir(directory.c_str());
+#else
+    mkdir(directory.c_str(), 0755);
+#endif
+    struct stat info;
+    return stat(directory.c_str(), &info) == 0 && (info.st_mode & S_IFDIR);
+}
+
+bool WriteCacheFile(const std::string& path, const void* header, size_t headerSize, const void* data, size_t dataSize) {
+    // The thread id keeps writers of the same entry, the hot-reload worker and the main thread, apart
+    std::string temporary = path + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        file.write(static_cast<const char*>(header), std::streamsize(headerSize));
+        file.write(static_cast<const char*>(data), std::streamsize(dataSize));
+        if (!file) {
+            file.close();
+            std::remove(temporary.c_str());
+            return false;
+        }
+    }
+#ifdef _WIN32
+    bool replaced = MoveFileExA(temporary.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0; // rename does not replace an existing file on Windows
+#else
+    bool replaced = std::rename(temporary.c_str(), path.c_str()) == 0; // Replaces the old entry atomically
+#endif
+    if (!replaced) {
+        std::remove(temporary.c_str());
+    }
+    return replaced;
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// File handling shared by the on-disk caches (program binaries, baked force field slices)
+
+// 64-bit FNV-1a, stable across runs and platforms unlike std::hash; pass the previous hash to continue it
+uint64_t Fnv1a(const std::string& data, uint64_t hash = 14695981039346656037ull);
+// The hash as 16 lowercase hex digits, for file names
+std::string HashHex(uint64_t hash);
+
+// Creates directory if needed, returns whether it exists as a directory afterwards
+bool MakeCacheDirectory(const std::string& directory);
+
+// Writes header then data under a private name and renames it over path, so a concurrent reader sees the
+// old entry or the whole new one. Returns false, leaving path untouched, if the write or the rename failed.
+bool WriteCacheFile(const std::string& path, const void* header, size_t headerSize, const void* data, size_t dataSize);
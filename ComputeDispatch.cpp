@@ -0,0 +1,55 @@
+#include "ComputeDispatch.h"
+#include <iostream>
+#include <algorithm>
+
+GLuint MaxComputeLocalSize() {
+    GLint maxSizeX = 0, maxInvocations = 0;
+    glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_SIZE, 0, &maxSizeX);
+    glGetIntegerv(GL_MAX_COMPUTE_WORK_GROUP_INVOCATIONS, &maxInvocations);
+    return static_cast<GLuint>(std::min(maxSizeX, maxInvocations));
+}
+
+GLuint MaxComputeGroupCountX() {
+    GLint maxCountX = 0;
+    glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_COUNT, 0, &maxCountX);
+    return static_cast<GLuint>(maxCountX);
+}
+
+bool ComputeDispatchSize(size_t itemCount, GLuint localSize, DispatchSize& size) {
+    GLint maxCountX = 0, maxCountY = 0;
+    glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_COUNT, 0, &maxCountX);
+    glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_COUNT, 1, &maxCountY);
+
+    size_t groups = (itemCount + localSize - 1) / localSize; // Ceiling division, the shader skips the overhang
+    if (groups <= size_t(maxCountX)) {
+        size.x = static_cast<GLuint>(std::max<size_t>(groups, 1));
+        size.y = 1;
+        size.z = 1;
+        return true;
+    }
+
+    // Fold into rows of at most maxCountX groups, spread evenly so the last row wastes as little as possible
+    size_t rows = (groups + maxCountX - 1) / maxCountX;
+    size_t columns = (groups + rows - 1) / rows;
+    if (rows > size_t(maxCountY)) {
+        std::cerr << "ERROR::DISPATCH::TOO_MANY_WORK_GROUPS " << groups << std::endl;
+        return false;
+    }
+    size.x = static_cast<GLuint>(columns);
+    size.y = static_cast<GLuint>(rows);
+    size.z = 1;
+    return true;
+}
+
+bool ComputeStorageBlocksFit(const std::string& programName, const std::vector<GLuint>& bindings) {
+    GLint maxBlocks = 0, maxBindings = 0;
+    glGetIntegerv(GL_MAX_COMPUTE_SHADER_STORAGE_BLOCKS, &maxBlocks);
+    glGetIntegerv(GL_MAX_SHADER_STORAGE_BUFFER_BINDINGS, &maxBindings);
+    GLuint highest = bindings.empty() ? 0 : *std::max_element(bindings.begin(), bindings.end());
+    if (bindings.size() <= size_t(maxBlocks) && GLint(highest) < maxBindings) {
+        return true;
+    }
+    std::cerr << "ERROR::SSBO::TOO_MANY_BLOCKS " << programName << " needs " << bindings.size() << " storage blocks at bindings up to " << highest
+        << ", the driver allows " << maxBlocks << " per compute shader and " << maxBindings << " bindings" << std::endl;
+    return false;
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <glew.h>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Work group counts for a glDispatchCompute call
+struct DispatchSize {
+    GLuint x = 0;
+    GLuint y = 1;
+    GLuint z = 1;
+};
+
+// Largest local_size_x the device accepts for a 1D work group
+GLuint MaxComputeLocalSize();
+
+// GL_MAX_COMPUTE_WORK_GROUP_COUNT in x, shaders that size their own dispatches fold past it the same way
+GLuint MaxComputeGroupCountX();
+
+// Work groups covering itemCount invocations of localSize each, rounded up.
+// Once the group count passes GL_MAX_COMPUTE_WORK_GROUP_COUNT in x it is folded into a 2D grid,
+// shaders flatten it back with gl_GlobalInvocationID.y * gl_NumWorkGroups.x * gl_WorkGroupSize.x + gl_GlobalInvocationID.x.
+// Returns false when the count does not fit the device limits.
+bool ComputeDispatchSize(size_t itemCount, GLuint localSize, DispatchSize& size);
+
+// Whether a compute program declaring storage blocks at bindings fits GL_MAX_COMPUTE_SHADER_STORAGE_BLOCKS
+// and GL_MAX_SHADER_STORAGE_BUFFER_BINDINGS. GL 4.3 only guarantees 8 of each. Declared blocks count even
+// when unused, as some drivers count them. Reports the program and the limits when it does not fit.
+bool ComputeStorageBlocksFit(const std::string& programName, const std::vector<GLuint>& bindings);
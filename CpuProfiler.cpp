@@ -0,0 +1,120 @@
+#include "CpuProfiler.h"
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+std::atomic<bool> CpuProfiler::capturing(false);
+
+namespace {
+    const size_t THREAD_EVENT_CAPACITY = 1 << 16; // Per thread and capture, 1.5 MB allocated on the thread's first event
+
+    struct Event {
+        const char* name;
+        int64_t begin;
+        int64_t end;
+    };
+
+    // Written by its thread only. Buffers are never freed, a trace may still reference a thread that has exited.
+    struct ThreadBuffer {
+        std::unique_ptr<Event[]> events;
+        std::atomic<size_t> count{ 0 };       // Published events, stored with release after the event itself
+        std::atomic<unsigned> capture{ 0 };   // Capture the events belong to
+        std::atomic<size_t> dropped{ 0 };
+        std::string name;                     // Guarded by registryMutex
+        int track = 0;
+    };
+
+    std::mutex registryMutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> registry;
+    std::atomic<unsigned> currentCapture(0);
+    int64_t captureStart = 0;
+    thread_local ThreadBuffer* threadBuffer = nullptr;
+
+    ThreadBuffer& LocalBuffer() {
+        if (!threadBuffer) {
+            std::lock_guard<std::mutex> lock(registryMutex);
+            registry.emplace_back(new ThreadBuffer());
+            threadBuffer = registry.back().get();
+            threadBuffer->track = static_cast<int>(registry.size());
+            threadBuffer->name = "thread " + std::to_string(threadBuffer->track);
+        }
+        return *threadBuffer;
+    }
+}
+
+void CpuProfiler::BeginCapture() {
+    captureStart = Now();
+    currentCapture.fetch_add(1, std::memory_order_relaxed);
+    capturing.store(true, std::memory_order_relaxed);
+}
+
+void CpuProfiler::EndCapture() {
+    capturing.store(false, std::memory_order_relaxed);
+}
+
+void CpuProfiler::SetThreadName(const std::string& name) {
+    ThreadBuffer& buffer = LocalBuffer();
+    std::lock_guard<std::mutex> lock(registryMutex);
+    buffer.name = name;
+}
+
+int64_t CpuProfiler::Now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void CpuProfiler::Record(const char* name, int64_t begin, int64_t end) {
+    ThreadBuffer& buffer = LocalBuffer();
+    unsigned capture = currentCapture.load(std::memory_order_relaxed);
+    if (buffer.capture.load(std::memory_order_relaxed) != capture || !buffer.events) {
+        // First event of this thread in a new capture, start the buffer over
+        if (!buffer.events) {
+            buffer.events.reset(new Event[THREAD_EVENT_CAPACITY]);
+        }
+        buffer.count.store(0, std::memory_order_relaxed);
+        buffer.dropped.store(0, std::memory_order_relaxed);
+        buffer.capture.store(capture, std::memory_order_release);
+    }
+    size_t count = buffer.count.load(std::memory_order_relaxed);
+    if (count == THREAD_EVENT_CAPACITY) {
+        buffer.dropped.store(buffer.dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return;
+    }
+    buffer.events[count] = { name, begin, end };
+    buffer.count.store(count + 1, std::memory_order_release);
+}
+
+void CpuProfiler::WriteChromeTrace(std::ostream& out) {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    unsigned capture = currentCapture.load(std::memory_order_relaxed);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    const char* separator = "\n";
+    for (const std::unique_ptr<ThreadBuffer>& buffer : registry) {
+        // Thread names are ours, nothing to escape
+        out << separator << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->track << ",\"args\":{\"name\":\"" << buffer->name << "\"}}";
+        separator = ",\n";
+        if (buffer->capture.load(std::memory_order_acquire) != capture) {
+            continue; // Nothing recorded on this thread in the last capture
+        }
+        size_t count = buffer->count.load(std::memory_order_acquire);
+        for (size_t i = 0; i < count; ++i) {
+            const Event& event = buffer->events[i];
+            out << ",\n{\"name\":\"" << event.name << "\",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->track
+                << ",\"ts\":" << (event.begin - captureStart) / 1000.0 << ",\"dur\":" << (event.end - event.begin) / 1000.0 << "}";
+        }
+    }
+    out << "\n]}\n";
+}
+
+size_t CpuProfiler::DroppedEvents() {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    unsigned capture = currentCapture.load(std::memory_order_relaxed);
+    size_t dropped = 0;
+    for (const std::unique_ptr<ThreadBuffer>& buffer : registry) {
+        if (buffer->capture.load(std::memory_order_acquire) == capture) {
+            dropped += buffer->dropped.load(std::memory_order_relaxed);
+        }
+    }
+    return dropped;
+}
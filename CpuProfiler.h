@@ -0,0 +1,54 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// CPU time of scoped zones on every thread, captured for a window of frames and exported as a Chrome
+// trace (chrome://tracing, ui.perfetto.dev). Each thread records into a fixed buffer of its own that
+// only it writes, publishing every event with one release store, so recording never takes a lock; the
+// writer reads what has been published. Outside a capture a zone costs one relaxed atomic load, cheap
+// enough to leave the zones in release builds.
+class CpuProfiler {
+public:
+    // Starts recording, events of the previous capture are discarded as each thread records again
+    static void BeginCapture();
+    static void EndCapture();
+    static bool Capturing() { return capturing.load(std::memory_order_relaxed); }
+
+    // Track name of the calling thread in the trace
+    static void SetThreadName(const std::string& name);
+
+    // Nanoseconds on the steady clock
+    static int64_t Now();
+    // Adds a zone to the calling thread's buffer. name is kept as a pointer and must outlive the
+    // capture: a string literal, or a string owned by something that lives as long
+    static void Record(const char* name, int64_t begin, int64_t end);
+
+    // Complete ("X") events of the last capture, one track per thread, microseconds since it began
+    static void WriteChromeTrace(std::ostream& out);
+    // Events lost to full thread buffers during the last capture
+    static size_t DroppedEvents();
+
+private:
+    static std::atomic<bool> capturing;
+};
+
+// Records the time between its construction and destruction as one zone of the calling thread
+class CpuZone {
+public:
+    explicit CpuZone(const char* zoneName) : name(CpuProfiler::Capturing() ? zoneName : nullptr), begin(name ? CpuProfiler::Now() : 0) {}
+    ~CpuZone() {
+        if (name) {
+            CpuProfiler::Record(name, begin, CpuProfiler::Now());
+        }
+    }
+
+    CpuZone(const CpuZone&) = delete;
+    CpuZone& operator=(const CpuZone&) = delete;
+
+private:
+    const char* name; // Null when the zone started outside a capture
+    int64_t begin;
+};
@@ -0,0 +1,348 @@
+#include "CpuSimulation.h"
+#include "ParticlePacking.h"
+#include "ParticleRandom.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define CPU_SIMULATION_X64
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and Clang only emit AVX2 code in functions that ask for it, MSVC accepts the intrinsics anywhere
+#if defined(CPU_SIMULATION_X64) && !defined(_MSC_VER)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+
+// Draws the next lifetime of the lanes set in mask, the rare path stays scalar
+static void RespawnLanes(ParticleBlock& block, size_t firstId, unsigned mask, const StepParameters& step) {
+    while (mask) {
+        int lane = 0;
+        while (!(mask & (1u << lane))) {
+            ++lane;
+        }
+        mask &= ~(1u << lane);
+        uint32_t id = static_cast<uint32_t>(firstId + lane);
+        ++block.respawnCount[lane];
+        if (step.emitters) {
+            // Everything of the new life comes from the particle's emitter
+            const EmitterParams& emitter = step.emitters[block.emitter[lane]];
+            glm::vec2 velocity = EmitterLaunchVelocity(emitter, step.seed, id, block.respawnCount[lane]);
+            glm::vec4 color = EmitterColor(emitter, step.seed, id, block.respawnCount[lane]);
+            block.positionX[lane] = emitter.position.x;
+            block.positionY[lane] = emitter.position.y;
+            block.lifeTime[lane] = EmitterLifetime(emitter, step.seed, id, block.respawnCount[lane]);
+            block.velocityX[lane] = velocity.x;
+            block.velocityY[lane] = velocity.y;
+            block.colorR[lane] = color.r;
+            block.colorG[lane] = color.g;
+            block.colorB[lane] = color.b;
+            continue;
+        }
+        block.lifeTime[lane] = ParticleLifetime(step.seed, id, block.respawnCount[lane]);
+        if (step.dynamicVelocity) {
+            glm::vec2 velocity = ParticleLaunchVelocity(step.seed, id);
+            block.velocityX[lane] = velocity.x;
+            block.velocityY[lane] = velocity.y;
+        }
+    }
+}
+
+static void UpdateBlocksScalar(ParticleBlock* blocks, size_t firstBlock, size_t lastBlock, const StepParameters& step) {
+    const float deltaTime = step.deltaTime;
+    for (size_t b = firstBlock; b < lastBlock; ++b) {
+        ParticleBlock& block = blocks[b];
+        for (int lane = 0; lane < ParticleBlock::WIDTH; ++lane) {
+            for (int s = 0; s < step.substeps; ++s) {
+                block.age[lane] += deltaTime;
+                block.colorA[lane] = 1.0f - (block.age[lane] / block.lifeTime[lane]);
+                if (block.age[lane] >= block.lifeTime[lane]) {
+                    block.positionX[lane] = step.mousePos.x;
+                    block.positionY[lane] = step.mousePos.y;
+                    block.age[lane] = 0.0f;
+                    block.colorA[lane] = 1.0f;
+                    RespawnLanes(block, b * ParticleBlock::WIDTH, 1u << lane, step);
+                }
+                else {
+                    block.positionX[lane] += (block.velocityX[lane] + step.positionBias.x) * deltaTime;
+                    block.positionY[lane] += (block.velocityY[lane] + step.positionBias.y) * deltaTime;
+                    block.velocityX[lane] += step.velocityStep.x;
+                    block.velocityY[lane] += step.velocityStep.y;
+                }
+            }
+        }
+    }
+}
+
+#if defined(CPU_SIMULATION_X64)
+// SSE2 is part of x86-64, each block is two groups of four lanes
+static void UpdateBlocksSse2(ParticleBlock* blocks, size_t firstBlock, size_t lastBlock, const StepParameters& step) {
+    const __m128 dt = _mm_set1_ps(step.deltaTime);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 mouseX = _mm_set1_ps(step.mousePos.x);
+    const __m128 mouseY = _mm_set1_ps(step.mousePos.y);
+    const __m128 biasX = _mm_set1_ps(step.positionBias.x);
+    const __m128 biasY = _mm_set1_ps(step.positionBias.y);
+    const __m128 dvX = _mm_set1_ps(step.velocityStep.x);
+    const __m128 dvY = _mm_set1_ps(step.velocityStep.y);
+    for (size_t b = firstBlock; b < lastBlock; ++b) {
+        ParticleBlock& block = blocks[b];
+        for (int s = 0; s < step.substeps; ++s) {
+            unsigned respawnMask = 0;
+            for (int lane = 0; lane < ParticleBlock::WIDTH; lane += 4) {
+                __m128 age = _mm_add_ps(_mm_loadu_ps(block.age + lane), dt);
+                __m128 lifeTime = _mm_loadu_ps(block.lifeTime + lane);
+                __m128 alpha = _mm_sub_ps(one, _mm_div_ps(age, lifeTime));
+                __m128 expired = _mm_cmpge_ps(age, lifeTime);
+
+                __m128 vx = _mm_loadu_ps(block.velocityX + lane);
+                __m128 vy = _mm_loadu_ps(block.velocityY + lane);
+                __m128 x = _mm_add_ps(_mm_loadu_ps(block.positionX + lane), _mm_mul_ps(_mm_add_ps(vx, biasX), dt));
+                __m128 y = _mm_add_ps(_mm_loadu_ps(block.positionY + lane), _mm_mul_ps(_mm_add_ps(vy, biasY), dt));
+
+                // select(expired, respawn, update) without SSE4.1 blendv; respawned velocities are redrawn by RespawnLanes
+                _mm_storeu_ps(block.positionX + lane, _mm_or_ps(_mm_and_ps(expired, mouseX), _mm_andnot_ps(expired, x)));
+                _mm_storeu_ps(block.positionY + lane, _mm_or_ps(_mm_and_ps(expired, mouseY), _mm_andnot_ps(expired, y)));
+                _mm_storeu_ps(block.velocityX + lane, _mm_or_ps(_mm_and_ps(expired, vx), _mm_andnot_ps(expired, _mm_add_ps(vx, dvX))));
+                _mm_storeu_ps(block.velocityY + lane, _mm_or_ps(_mm_and_ps(expired, vy), _mm_andnot_ps(expired, _mm_add_ps(vy, dvY))));
+                _mm_storeu_ps(block.age + lane, _mm_or_ps(_mm_and_ps(expired, zero), _mm_andnot_ps(expired, age)));
+                _mm_storeu_ps(block.colorA + lane, _mm_or_ps(_mm_and_ps(expired, one), _mm_andnot_ps(expired, alpha)));
+                respawnMask |= unsigned(_mm_movemask_ps(expired)) << lane;
+            }
+            RespawnLanes(block, b * ParticleBlock::WIDTH, respawnMask, step);
+        }
+    }
+}
+
+TARGET_AVX2
+static void UpdateBlocksAvx2(ParticleBlock* blocks, size_t firstBlock, size_t lastBlock, const StepParameters& step) {
+    const __m256 dt = _mm256_set1_ps(step.deltaTime);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 mouseX = _mm256_set1_ps(step.mousePos.x);
+    const __m256 mouseY = _mm256_set1_ps(step.mousePos.y);
+    const __m256 biasX = _mm256_set1_ps(step.positionBias.x);
+    const __m256 biasY = _mm256_set1_ps(step.positionBias.y);
+    const __m256 dvX = _mm256_set1_ps(step.velocityStep.x);
+    const __m256 dvY = _mm256_set1_ps(step.velocityStep.y);
+    for (size_t b = firstBlock; b < lastBlock; ++b) {
+        ParticleBlock& block = blocks[b];
+        // The block stays in registers across the substeps, only respawns go through memory
+        __m256 x = _mm256_loadu_ps(block.positionX);
+        __m256 y = _mm256_loadu_ps(block.positionY);
+        __m256 vx = _mm256_loadu_ps(block.velocityX);
+        __m256 vy = _mm256_loadu_ps(block.velocityY);
+        __m256 age = _mm256_loadu_ps(block.age);
+        __m256 alpha = _mm256_loadu_ps(block.colorA);
+        __m256 lifeTime = _mm256_loadu_ps(block.lifeTime);
+        for (int s = 0; s < step.substeps; ++s) {
+            age = _mm256_add_ps(age, dt);
+            alpha = _mm256_sub_ps(one, _mm256_div_ps(age, lifeTime));
+            __m256 expired = _mm256_cmp_ps(age, lifeTime, _CMP_GE_OQ);
+
+            // Separate multiply and add, no FMA, to round like the unfused GLSL expression
+            x = _mm256_blendv_ps(_mm256_add_ps(x, _mm256_mul_ps(_mm256_add_ps(vx, biasX), dt)), mouseX, expired);
+            y = _mm256_blendv_ps(_mm256_add_ps(y, _mm256_mul_ps(_mm256_add_ps(vy, biasY), dt)), mouseY, expired);
+            vx = _mm256_blendv_ps(_mm256_add_ps(vx, dvX), vx, expired);
+            vy = _mm256_blendv_ps(_mm256_add_ps(vy, dvY), vy, expired);
+            age = _mm256_blendv_ps(age, zero, expired);
+            alpha = _mm256_blendv_ps(alpha, one, expired);
+
+            unsigned respawnMask = unsigned(_mm256_movemask_ps(expired));
+            if (respawnMask) {
+                _mm256_storeu_ps(block.positionX, x);
+                _mm256_storeu_ps(block.positionY, y);
+                _mm256_storeu_ps(block.velocityX, vx);
+                _mm256_storeu_ps(block.velocityY, vy);
+                RespawnLanes(block, b * ParticleBlock::WIDTH, respawnMask, step);
+                x = _mm256_loadu_ps(block.positionX); // Emitters move respawns away from the mouse
+                y = _mm256_loadu_ps(block.positionY);
+                vx = _mm256_loadu_ps(block.velocityX);
+                vy = _mm256_loadu_ps(block.velocityY);
+                lifeTime = _mm256_loadu_ps(block.lifeTime);
+            }
+        }
+        _mm256_storeu_ps(block.positionX, x);
+        _mm256_storeu_ps(block.positionY, y);
+        _mm256_storeu_ps(block.velocityX, vx);
+        _mm256_storeu_ps(block.velocityY, vy);
+        _mm256_storeu_ps(block.age, age);
+        _mm256_storeu_ps(block.colorA, alpha);
+    }
+}
+
+static bool CpuSupportsAvx2() {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    bool osSavesAvx = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6; // OSXSAVE, AVX, YMM state enabled
+    __cpuidex(info, 7, 0);
+    return osSavesAvx && (info[1] & (1 << 5));
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+void CpuSimulation::Init(const std::vector<Particle>& particles, unsigned threadCount, uint32_t randomSeed) {
+    seed = randomSeed;
+    SetParticles(particles);
+
+    kernel = Kernel::Scalar;
+#if defined(CPU_SIMULATION_X64)
+    kernel = CpuSupportsAvx2() ? Kernel::Avx2 : Kernel::Sse2;
+#endif
+    pool.reset(new ThreadPool(threadCount));
+}
+
+void CpuSimulation::SetParticles(const std::vector<Particle>& particles) {
+    particleCount = particles.size();
+    size_t blockCount = (particleCount + ParticleBlock::WIDTH - 1) / ParticleBlock::WIDTH;
+
+    // Padding lanes of the last block get a harmless particle that is simulated but never read back
+    ParticleBlock padding;
+    for (int lane = 0; lane < ParticleBlock::WIDTH; ++lane) {
+        padding.positionX[lane] = padding.positionY[lane] = 0.0f;
+        padding.velocityX[lane] = padding.velocityY[lane] = 0.0f;
+        padding.colorR[lane] = padding.colorG[lane] = padding.colorB[lane] = padding.colorA[lane] = 0.0f;
+        padding.age[lane] = 0.0f;
+        padding.lifeTime[lane] = 1.0f;
+        padding.respawnCount[lane] = 0;
+        padding.emitter[lane] = 0;
+    }
+    blocks.assign(blockCount, padding);
+    for (size_t i = 0; i < particleCount; ++i) {
+        ParticleBlock& block = blocks[i / ParticleBlock::WIDTH];
+        size_t lane = i % ParticleBlock::WIDTH;
+        const Particle& particle = particles[i];
+        block.positionX[lane] = particle.position.x;
+        block.positionY[lane] = particle.position.y;
+        block.velocityX[lane] = particle.velocity.x;
+        block.velocityY[lane] = particle.velocity.y;
+        block.colorR[lane] = particle.color.r;
+        block.colorG[lane] = particle.color.g;
+        block.colorB[lane] = particle.color.b;
+        block.colorA[lane] = particle.color.a;
+        block.age[lane] = particle.age;
+        block.lifeTime[lane] = particle.lifeTime;
+        block.respawnCount[lane] = particle.respawnCount;
+        block.emitter[lane] = particle.emitter;
+    }
+}
+
+const char* CpuSimulation::KernelName() const {
+    switch (kernel) {
+    case Kernel::Scalar: return "scalar";
+    case Kernel::Sse2: return "sse2";
+    case Kernel::Avx2: return "avx2";
+    }
+    return "unknown";
+}
+
+// Enough chunks per thread for stealing to even out, big enough that the per-chunk overhead disappears
+size_t CpuSimulation::BlocksPerChunk() const {
+    size_t perThread = blocks.size() / (size_t(ThreadCount()) * 8);
+    return std::min<size_t>(std::max<size_t>(perThread, 64), 4096);
+}
+
+void CpuSimulation::SetForces(glm::vec2 acceleration, ParticleIntegrator particleIntegrator) {
+    gravity = acceleration;
+    integrator = particleIntegrator;
+}
+
+void CpuSimulation::Update(float deltaTime, int substeps, glm::vec2 mousePos) {
+    if (substeps <= 0) {
+        return;
+    }
+    StepParameters step;
+    step.deltaTime = deltaTime;
+    step.substeps = substeps;
+    step.mousePos = mousePos;
+    step.dynamicVelocity = gravity != glm::vec2(0.0f) || emitters;
+    step.emitters = emitters ? emitters->data() : nullptr;
+    step.seed = seed;
+    // With a constant acceleration every integrator adds the same velocity step, they differ in the
+    // velocity the position moves with; the products round like the shader's
+    step.velocityStep = gravity * deltaTime;
+    switch (integrator) {
+    case ParticleIntegrator::ExplicitEuler: step.positionBias = glm::vec2(0.0f); break;
+    case ParticleIntegrator::SemiImplicitEuler: step.positionBias = step.velocityStep; break;
+    case ParticleIntegrator::VelocityVerlet: step.positionBias = 0.5f * deltaTime * gravity; break;
+    }
+
+    ParticleBlock* data = blocks.data();
+    Kernel selected = kernel;
+    pool->ParallelFor(blocks.size(), BlocksPerChunk(), [=](size_t begin, size_t end) {
+        switch (selected) {
+#if defined(CPU_SIMULATION_X64)
+        case Kernel::Avx2: UpdateBlocksAvx2(data, begin, end, step); break;
+        case Kernel::Sse2: UpdateBlocksSse2(data, begin, end, step); break;
+#endif
+        default: UpdateBlocksScalar(data, begin, end, step); break;
+        }
+    });
+}
+
+Particle CpuSimulation::GetParticle(size_t index) const {
+    const ParticleBlock& block = blocks[index / ParticleBlock::WIDTH];
+    size_t lane = index % ParticleBlock::WIDTH;
+    Particle particle = {};
+    particle.position = glm::vec2(block.positionX[lane], block.positionY[lane]);
+    particle.velocity = glm::vec2(block.velocityX[lane], block.velocityY[lane]);
+    particle.color = glm::vec4(block.colorR[lane], block.colorG[lane], block.colorB[lane], block.colorA[lane]);
+    particle.age = block.age[lane];
+    particle.lifeTime = block.lifeTime[lane];
+    particle.respawnCount = block.respawnCount[lane];
+    particle.emitter = block.emitter[lane];
+    return particle;
+}
+
+void CpuSimulation::Upload(const ParticleStorage& storage) {
+    const bool packed = storage.Layout() == ParticleLayout::Packed;
+    const size_t grain = BlocksPerChunk() * ParticleBlock::WIDTH;
+    for (size_t s = 0; s < storage.Streams().size(); ++s) {
+        const ParticleStream& stream = storage.Streams()[s];
+        if (!stream.simulated) {
+            continue; // Never changes, the initial upload still holds
+        }
+
+        // Invalidating lets the driver hand out fresh memory instead of waiting for the last draw
+        GLsizeiptr size = GLsizeiptr(particleCount) * stream.elementSize;
+        glBindBuffer(GL_COPY_WRITE_BUFFER, storage.TargetBuffer(s));
+        unsigned char* mapped = static_cast<unsigned char*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+        if (!mapped) {
+            std::cerr << "ERROR::CPU_SIMULATION::MAP_FAILED " << stream.name << std::endl;
+            continue;
+        }
+
+        pool->ParallelFor(particleCount, grain, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                Particle particle = GetParticle(i);
+                unsigned char* element = mapped + i * stream.elementSize;
+                if (packed) {
+                    PackedParticle record = PackParticle(particle);
+                    std::memcpy(element, &record, sizeof(record));
+                }
+                else {
+                    std::memcpy(element, reinterpret_cast<const unsigned char*>(&particle) + stream.particleOffset, stream.elementSize);
+                }
+            }
+        });
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void CpuSimulation::ReadParticles(std::vector<Particle>& particles) const {
+    particles.resize(particleCount);
+    for (size_t i = 0; i < particleCount; ++i) {
+        particles[i] = GetParticle(i);
+    }
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include <glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "Particle.h"
+#include "ParticleEmitters.h"
+#include "ParticleStorage.h"
+#include "ThreadPool.h"
+
+// Eight particles with each field stored contiguously (AoSoA), so one AVX load covers a field of the block
+struct ParticleBlock {
+    static const int WIDTH = 8;
+    float positionX[WIDTH];
+    float positionY[WIDTH];
+    float velocityX[WIDTH];
+    float velocityY[WIDTH];
+    float colorR[WIDTH];
+    float colorG[WIDTH];
+    float colorB[WIDTH];
+    float colorA[WIDTH];
+    float age[WIDTH];
+    float lifeTime[WIDTH];
+    uint32_t respawnCount[WIDTH];
+    uint32_t emitter[WIDTH];
+};
+
+// Inputs of one Update(), shared by every kernel
+struct StepParameters {
+    float deltaTime;        // Length of one step
+    int substeps;
+    glm::vec2 mousePos;
+    glm::vec2 velocityStep; // Added to the velocity every step
+    glm::vec2 positionBias; // Added to the velocity the position moves with, what sets the integrators apart
+    bool dynamicVelocity;   // Respawns redraw the launch velocity
+    const EmitterParams* emitters; // Respawn from the particle's emitter instead of the mouse, null without a table
+    uint32_t seed;
+};
+
+// CPU implementation of the update in compute_shader.glsl main(), for machines without usable compute shaders.
+// Blocks are split across a ThreadPool and each one is updated by the widest SIMD kernel the CPU supports.
+class CpuSimulation {
+public:
+    // threadCount 0 uses every hardware thread, seed keys the respawn lifetimes like the shader's seed uniform
+    void Init(const std::vector<Particle>& particles, unsigned threadCount, uint32_t seed);
+
+    // Replaces the whole state, the particle count may change
+    void SetParticles(const std::vector<Particle>& particles);
+
+    // Constant acceleration acting on every particle and the integrator applying it, like the
+    // DYNAMIC_VELOCITY and INTEGRATOR_* variants of the shader. No forces by default.
+    void SetForces(glm::vec2 gravity, ParticleIntegrator integrator);
+
+    // Respawns from each particle's entry of the table, like the EMITTERS variant of the shader; null
+    // respawns at the mouse. The table is read at every Update(), changes to it apply from then on.
+    void SetEmitters(const std::vector<EmitterParams>* emitterTable) { emitters = emitterTable; }
+
+    // Same substeps of deltaTime as one dispatch of the compute shader
+    void Update(float deltaTime, int substeps, glm::vec2 mousePos);
+
+    // Writes the simulated streams into the storage's target buffers so the usual draw can consume them
+    void Upload(const ParticleStorage& storage);
+
+    // Copies the state back out as Particle records
+    void ReadParticles(std::vector<Particle>& particles) const;
+
+    size_t Count() const { return particleCount; }
+    unsigned ThreadCount() const { return pool ? pool->ThreadCount() : 0; }
+    const char* KernelName() const; // Instruction set of the selected kernel
+
+private:
+    enum class Kernel { Scalar, Sse2, Avx2 };
+
+    Particle GetParticle(size_t index) const;
+    size_t BlocksPerChunk() const;
+
+    std::vector<ParticleBlock> blocks;
+    std::unique_ptr<ThreadPool> pool;
+    size_t particleCount = 0;
+    uint32_t seed = 0;
+    glm::vec2 gravity = glm::vec2(0.0f);
+    const std::vector<EmitterParams>* emitters = nullptr;
+    ParticleIntegrator integrator = ParticleIntegrator::ExplicitEuler;
+    Kernel kernel = Kernel::Scalar;
+};
@@ -0,0 +1,309 @@
+#include "CurlNoiseField.h"
+#include "CacheFile.h"
+#include "CpuProfiler.h"
+#include "ParticleRandom.h"
+#include <gtc/noise.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+static const float TWO_PI = 6.28318530718f;
+
+// Written in front of every cached slice, a mismatch means the file is not ours or was cut short
+struct CurlSliceHeader {
+    char magic[8];
+    int32_t resolution;
+    int32_t padding;
+    int64_t slice;
+};
+
+static const char CURL_SLICE_MAGIC[8] = { 'S', 'L', 'C', 'U', 'R', 'L', '0', '1' };
+
+static std::string FloatBits(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return std::to_string(bits);
+}
+
+bool CurlNoiseField::Init(const CurlNoiseSettings& fieldSettings, float slicePeriod, const std::string& directory, unsigned threadCount) {
+    settings = fieldSettings;
+    settings.cycleSlices = std::max(settings.cycleSlices, 1);
+    period = slicePeriod;
+    pool.reset(new ThreadPool(threadCount));
+    for (int64_t& slice : ringSlice) {
+        slice = -1;
+    }
+
+    // A directory that cannot be made only costs the cache, the field still bakes
+    cacheDirectory.clear();
+    if (!directory.empty()) {
+        if (MakeCacheDirectory(directory)) {
+            cacheDirectory = directory;
+        }
+        else {
+            std::cerr << "ERROR::CURL_NOISE::CACHE_DIRECTORY " << directory << std::endl;
+        }
+    }
+    uint64_t hash = Fnv1a("curl noise 2\n" + std::to_string(settings.resolution) + " " + FloatBits(settings.frequency) + " " +
+        std::to_string(settings.octaves) + " " + FloatBits(settings.sliceSpacing) + " " + std::to_string(settings.cycleSlices) + " " +
+        std::to_string(settings.seed));
+    cacheKey = HashHex(hash);
+
+    // Clamped in space, particles past the edge feel the edge's force; wrapped in time, the ring's layers
+    // follow each other in slice order whichever of them holds the earlier slice
+    const GLsizei size = settings.resolution;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_3D, texture);
+    glTexStorage3D(GL_TEXTURE_3D, 1, GL_RG16F, size, size, RING_SLICES);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_REPEAT);
+    glBindTexture(GL_TEXTURE_3D, 0);
+    if (glGetError() == GL_OUT_OF_MEMORY) {
+        std::cerr << "ERROR::CURL_NOISE::OUT_OF_MEMORY" << std::endl;
+        return false;
+    }
+
+    jobSlice = -1;
+    jobDone = false;
+    stopping = false;
+    bakedSlices = 0;
+    cachedSlices = 0;
+    bakeMilliseconds = 0.0;
+    baker = std::thread(&CurlNoiseField::BakerLoop, this);
+    FillRing(0);
+    return true;
+}
+
+void CurlNoiseField::Destroy() {
+    StopBaker();
+    glDeleteTextures(1, &texture);
+    texture = 0;
+    pool.reset();
+    std::vector<float>().swap(potential);
+    std::vector<glm::vec2>().swap(texels);
+    std::vector<glm::vec2>().swap(jobTexels);
+}
+
+void CurlNoiseField::StopBaker() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    changed.notify_all();
+    if (baker.joinable()) {
+        baker.join();
+    }
+}
+
+float CurlNoiseField::Update(double time) {
+    const double position = period > 0.0f ? time / period : 0.0;
+    const int64_t first = static_cast<int64_t>(std::floor(position));
+    FillRing(first);
+
+    // The slice that scrolls in next is prepared while these two are in use
+    if (period > 0.0f) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (jobSlice != first + RING_SLICES) {
+            Request(first + RING_SLICES, lock);
+        }
+    }
+
+    // Texel centres of the layers sit at (layer + 0.5) / RING_SLICES, only the position within the ring matters
+    const double ring = position - RING_SLICES * std::floor(position / RING_SLICES);
+    return static_cast<float>((ring + 0.5) / RING_SLICES);
+}
+
+void CurlNoiseField::FillRing(int64_t first) {
+    for (int64_t slice = first; slice < first + RING_SLICES; ++slice) {
+        const int layer = static_cast<int>(slice % RING_SLICES);
+        if (ringSlice[layer] == slice) {
+            continue;
+        }
+        Take(slice, texels);
+        glBindTexture(GL_TEXTURE_3D, texture);
+        glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, layer, settings.resolution, settings.resolution, 1, GL_RG, GL_FLOAT, texels.data());
+        glBindTexture(GL_TEXTURE_3D, 0);
+        ringSlice[layer] = slice;
+    }
+}
+
+void CurlNoiseField::Request(int64_t slice, std::unique_lock<std::mutex>& lock) {
+    // A slice time skipped past is let finish, the pool is the baker's until then
+    changed.wait(lock, [this]() { return jobSlice == -1 || jobDone; });
+    jobSlice = slice;
+    jobDone = false;
+    changed.notify_all();
+}
+
+void CurlNoiseField::Take(int64_t slice, std::vector<glm::vec2>& sliceTexels) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (jobSlice != slice) {
+        Request(slice, lock);
+    }
+    if (!jobDone) {
+        CpuZone zone("wait for field slice");
+        changed.wait(lock, [this]() { return jobDone; });
+    }
+    sliceTexels.swap(jobTexels); // The baker reuses the previous slice's storage
+    jobSlice = -1;
+    jobDone = false;
+}
+
+void CurlNoiseField::BakerLoop() {
+    CpuProfiler::SetThreadName("field baker");
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        changed.wait(lock, [this]() { return stopping || (jobSlice != -1 && !jobDone); });
+        if (stopping) {
+            return;
+        }
+        const int64_t cycleSlice = jobSlice % settings.cycleSlices;
+        std::vector<glm::vec2> sliceTexels;
+        sliceTexels.swap(jobTexels);
+        lock.unlock();
+
+        // Nothing else touches the pool, the scratch or the files while a slice is being made
+        auto bakeStart = std::chrono::high_resolution_clock::now();
+        const bool cached = LoadSlice(cycleSlice, sliceTexels);
+        if (!cached) {
+            BakeSlice(cycleSlice, sliceTexels);
+            StoreSlice(cycleSlice, sliceTexels);
+        }
+        const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - bakeStart).count();
+
+        lock.lock();
+        if (cached) {
+            ++cachedSlices;
+        }
+        else {
+            ++bakedSlices;
+            bakeMilliseconds += milliseconds;
+        }
+        jobTexels.swap(sliceTexels);
+        jobDone = true;
+        changed.notify_all();
+    }
+}
+
+int CurlNoiseField::BakedSlices() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return bakedSlices;
+}
+
+int CurlNoiseField::CachedSlices() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return cachedSlices;
+}
+
+double CurlNoiseField::BakeMilliseconds() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return bakeMilliseconds;
+}
+
+void CurlNoiseField::Bind() const {
+    glActiveTexture(GL_TEXTURE0 + FORCE_FIELD_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_3D, texture);
+}
+
+std::string CurlNoiseField::SlicePath(int64_t cycleSlice) const {
+    return cacheDirectory + "/curl-" + cacheKey + "-" + std::to_string(cycleSlice) + ".bin";
+}
+
+bool CurlNoiseField::LoadSlice(int64_t cycleSlice, std::vector<glm::vec2>& sliceTexels) {
+    if (cacheDirectory.empty()) {
+        return false;
+    }
+    CpuZone zone("load field slice");
+    std::ifstream file(SlicePath(cycleSlice), std::ios::binary);
+    CurlSliceHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, CURL_SLICE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.resolution != settings.resolution || header.slice != cycleSlice) {
+        return false;
+    }
+    sliceTexels.resize(size_t(settings.resolution) * size_t(settings.resolution));
+    if (!file.read(reinterpret_cast<char*>(sliceTexels.data()), std::streamsize(sliceTexels.size() * sizeof(glm::vec2))) ||
+        file.peek() != std::ifstream::traits_type::eof()) {
+        return false;
+    }
+    return true;
+}
+
+void CurlNoiseField::StoreSlice(int64_t cycleSlice, const std::vector<glm::vec2>& sliceTexels) const {
+    if (cacheDirectory.empty()) {
+        return;
+    }
+    CurlSliceHeader header;
+    std::memcpy(header.magic, CURL_SLICE_MAGIC, sizeof(header.magic));
+    header.resolution = settings.resolution;
+    header.padding = 0;
+    header.slice = cycleSlice;
+
+    std::string path = SlicePath(cycleSlice);
+    if (!WriteCacheFile(path, &header, sizeof(header), sliceTexels.data(), sliceTexels.size() * sizeof(glm::vec2))) {
+        std::cerr << "ERROR::CURL_NOISE::WRITE_FAILED " << path << std::endl;
+    }
+}
+
+void CurlNoiseField::BakeSlice(int64_t cycleSlice, std::vector<glm::vec2>& sliceTexels) {
+    CpuZone zone("bake field slice");
+    const int size = settings.resolution;
+    const int border = size + 2; // The potential reaches one texel past each edge for the central differences
+    const float texel = 2.0f / float(size);
+
+    // Noise time is a circle through two extra noise dimensions, its circumference spans the cycle's slices
+    // sliceSpacing apart, so the last slice leads back into the first
+    const float angle = TWO_PI * float(cycleSlice) / float(settings.cycleSlices);
+    const float radius = float(settings.cycleSlices) * settings.sliceSpacing / TWO_PI;
+    const glm::vec2 time = radius * glm::vec2(std::cos(angle), std::sin(angle));
+    potential.resize(size_t(border) * size_t(border));
+    sliceTexels.resize(size_t(size) * size_t(size));
+
+    // Octaves of the potential, each at twice the frequency of the last, half its amplitude and its own offset into the noise
+    std::vector<glm::vec4> offsets(size_t(std::max(settings.octaves, 0)));
+    float amplitudeSum = 0.0f;
+    for (int octave = 0; octave < settings.octaves; ++octave) {
+        glm::uvec3 bits = ParticleRandom(settings.seed, static_cast<uint32_t>(octave), PARTICLE_RANDOM_INIT_COUNTER);
+        offsets[octave] = glm::vec4(RandomUnit(bits.x), RandomUnit(bits.y), RandomUnit(bits.z), 0.0f) * 256.0f;
+        amplitudeSum += 1.0f / float(1 << octave);
+    }
+    const float scale = 0.5f * settings.frequency; // NDC spans two units
+    auto potentialAt = [&](float x, float y) {
+        float value = 0.0f;
+        for (int octave = 0; octave < settings.octaves; ++octave) {
+            float octaveScale = float(1 << octave);
+            value += glm::simplex(glm::vec4(x * scale, y * scale, time.x, time.y) * octaveScale + offsets[octave]) / octaveScale;
+        }
+        return value / amplitudeSum;
+    };
+
+    // Texel centres of row r lie at y = -1 + (r - 0.5) * texel, row 0 being the border below the field
+    pool->ParallelFor(size_t(border), 4, [&](size_t begin, size_t end) {
+        for (size_t row = begin; row < end; ++row) {
+            float y = -1.0f + (float(row) - 0.5f) * texel;
+            for (int column = 0; column < border; ++column) {
+                potential[row * border + column] = potentialAt(-1.0f + (float(column) - 0.5f) * texel, y);
+            }
+        }
+    });
+
+    // velocity = (dpsi/dy, -dpsi/dx), divergence free. The derivatives grow with the frequency, dividing
+    // it back out keeps the magnitude the same at every scale, the strength uniform sets it.
+    const float derivative = 1.0f / (2.0f * texel * scale);
+    pool->ParallelFor(size_t(size), 8, [&](size_t begin, size_t end) {
+        for (size_t row = begin; row < end; ++row) {
+            const float* center = &potential[(row + 1) * border + 1];
+            for (int column = 0; column < size; ++column) {
+                float dy = center[column + border] - center[column - border];
+                float dx = center[column + 1] - center[column - 1];
+                sliceTexels[row * size + column] = glm::vec2(dy, -dx) * derivative;
+            }
+        }
+    });
+}
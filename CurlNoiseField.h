@@ -0,0 +1,97 @@
+#pragma once
+#include <glew.h>
+#include <glm.hpp>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ShaderProgram.h"
+#include "ThreadPool.h"
+
+// Shape of the baked field; every setting is part of the cache key of a baked slice
+struct CurlNoiseSettings {
+    int resolution = 128;       // Texels along each side of a slice, covering NDC [-1, 1]
+    float frequency = 2.0f;     // Noise features across the field
+    int octaves = 3;            // Each one doubles the frequency and halves the amplitude
+    float sliceSpacing = 0.25f; // Distance in noise time between two baked slices
+    int cycleSlices = 64;       // Slices before the noise time wraps around, bounds the cache to as many files
+    uint32_t seed = 1;          // Offsets the noise domain, the same seed bakes the same field
+};
+
+// Texture unit of forceField in compute_shader.glsl
+const GLuint FORCE_FIELD_TEXTURE_UNIT = 0;
+
+// Divergence-free turbulence for the compute shader, baked instead of evaluated per particle per frame.
+// A slice is the 2D curl of a simplex noise potential (glm gtc/noise) at one point in noise time, baked
+// row by row across a ThreadPool and cached on disk. Noise time runs around a circle, so the field repeats
+// after cycleSlices slices and the cache never holds more. The texture is a ring of two slices, the one at
+// or before the current time and the one after it; hardware filtering interpolates in space and between
+// the two. A baker thread loads or bakes the slice after those two while the field is in use, when time
+// moves on it is only uploaded.
+class CurlNoiseField {
+public:
+    ~CurlNoiseField() { StopBaker(); }
+
+    // slicePeriod is the simulated time between two slices, 0 freezes the field at slice 0.
+    // cacheDirectory may be empty, threadCount 0 bakes on every hardware thread.
+    // Fills the texture for time 0 before returning.
+    bool Init(const CurlNoiseSettings& settings, float slicePeriod, const std::string& cacheDirectory, unsigned threadCount);
+    void Destroy();
+
+    // Makes sure the two slices around time are in the texture, returns forceField's third coordinate for it.
+    // Only waits for the baker when time skipped past the slice it prepared.
+    float Update(double time);
+
+    // Turns on the forceField sampling of compute_shader.glsl, the variant must have DYNAMIC_VELOCITY too
+    static ShaderDefines Defines() { return ShaderDefines().Set("FORCE_FIELD"); }
+
+    void Bind() const;
+
+    // Slices made since Init, baked and read from the cache, and the time spent baking them
+    int BakedSlices() const;
+    int CachedSlices() const;
+    double BakeMilliseconds() const;
+
+private:
+    static const int RING_SLICES = 2;
+
+    // Fills the ring for the slices around position, taking each from the baker
+    void FillRing(int64_t first);
+    // Hands slice to the baker, after it finished the one it had
+    void Request(int64_t slice, std::unique_lock<std::mutex>& lock);
+    // Texels of slice, waits for the baker if it is not done yet
+    void Take(int64_t slice, std::vector<glm::vec2>& sliceTexels);
+    void BakerLoop();
+    void StopBaker();
+
+    // Baker thread only
+    bool LoadSlice(int64_t cycleSlice, std::vector<glm::vec2>& texels);
+    void StoreSlice(int64_t cycleSlice, const std::vector<glm::vec2>& texels) const;
+    void BakeSlice(int64_t cycleSlice, std::vector<glm::vec2>& texels);
+    std::string SlicePath(int64_t cycleSlice) const;
+
+    CurlNoiseSettings settings;
+    float period = 0.0f;
+    std::string cacheDirectory; // Empty when slices are not cached
+    std::string cacheKey;       // Hash of the settings, shared by every slice file
+    std::unique_ptr<ThreadPool> pool;
+    std::vector<float> potential; // Scratch of a bake, the potential one texel beyond each edge
+    std::vector<glm::vec2> texels; // Main thread, the slice being uploaded
+    int64_t ringSlice[RING_SLICES]; // Slice held by each layer of the texture, -1 when empty
+    GLuint texture = 0;
+
+    // Shared with the baker thread under mutex
+    std::thread baker;
+    mutable std::mutex mutex;
+    std::condition_variable changed; // A slice was requested or finished
+    int64_t jobSlice = -1;           // Slice requested from the baker, -1 when none
+    bool jobDone = false;
+    bool stopping = false;
+    std::vector<glm::vec2> jobTexels;
+    int bakedSlices = 0;
+    int cachedSlices = 0;
+    double bakeMilliseconds = 0.0;
+};
@@ -0,0 +1,16 @@
+#include "EmbeddedShaders.h"
+
+#ifdef SHADERLOADER_EMBED_SHADERS
+// Defines embeddedShaders[], one constexpr char array per .glsl of the project
+#include "EmbeddedShaderData.inc"
+
+const EmbeddedShader* EmbeddedShaders(size_t& count) {
+    count = sizeof(embeddedShaders) / sizeof(embeddedShaders[0]);
+    return embeddedShaders;
+}
+#else
+const EmbeddedShader* EmbeddedShaders(size_t& count) {
+    count = 0;
+    return nullptr;
+}
+#endif
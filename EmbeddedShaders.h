@@ -0,0 +1,13 @@
+#pragma once
+#include <cstddef>
+
+// A .glsl file compiled into the executable, path as the project lists it
+struct EmbeddedShader {
+    const char* path;
+    const char* source;
+    size_t size;
+};
+
+// The embedded shaders, generated at build time by EmbedShaders.targets. Empty (count 0) unless the
+// build defines SHADERLOADER_EMBED_SHADERS.
+const EmbeddedShader* EmbeddedShaders(size_t& count);
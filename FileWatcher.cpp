@@ -0,0 +1,131 @@
+#include "FileWatcher.h"
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+static const int SETTLE_MS = 50; // Editors often write a file in several steps
+
+static bool ModifiedTime(const std::string& path, long long& time) {
+#ifdef _WIN32
+    struct _stat64 info;
+    if (_stat64(path.c_str(), &info) != 0) {
+        return false;
+    }
+#else
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0) {
+        return false;
+    }
+#endif
+    time = static_cast<long long>(info.st_mtime);
+    return true;
+}
+
+FileWatcher::~FileWatcher() {
+    Destroy();
+}
+
+bool FileWatcher::Init(const std::vector<std::string>& paths) {
+    Destroy();
+    for (const std::string& path : paths) {
+        WatchedFile file;
+        file.path = path;
+        size_t slash = path.find_last_of("/\\");
+        file.directory = slash == std::string::npos ? "." : path.substr(0, slash);
+        file.fileName = slash == std::string::npos ? path : path.substr(slash + 1);
+        ModifiedTime(path, file.modifiedTime);
+        files.push_back(file);
+    }
+
+#ifdef __linux__
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd < 0) {
+        std::cerr << "ERROR::FILE_WATCHER::INOTIFY_INIT_FAILED" << std::endl;
+        return false;
+    }
+    for (WatchedFile& file : files) {
+        // Watching one directory again returns its existing descriptor
+        file.watch = inotify_add_watch(inotifyFd, file.directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+        if (file.watch < 0) {
+            std::cerr << "ERROR::FILE_WATCHER::WATCH_FAILED " << file.directory << std::endl;
+            return false;
+        }
+    }
+#endif
+    return true;
+}
+
+void FileWatcher::Destroy() {
+#ifdef __linux__
+    if (inotifyFd >= 0) {
+        close(inotifyFd); // Drops the watches with it
+        inotifyFd = -1;
+    }
+#endif
+    files.clear();
+}
+
+std::vector<std::string> FileWatcher::Wait(int timeoutMs) {
+    std::vector<bool> changed(files.size(), false);
+
+#ifdef __linux__
+    // Drain events until none arrive for SETTLE_MS, only the first poll waits the full timeout
+    int wait = timeoutMs;
+    pollfd descriptor = { inotifyFd, POLLIN, 0 };
+    while (inotifyFd >= 0 && poll(&descriptor, 1, wait) > 0) {
+        alignas(inotify_event) char buffer[4096];
+        ssize_t length = read(inotifyFd, buffer, sizeof(buffer));
+        for (ssize_t offset = 0; offset < length; ) {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+            if (event->len > 0) {
+                for (size_t i = 0; i < files.size(); ++i) {
+                    if (files[i].watch == event->wd && files[i].fileName == event->name) {
+                        changed[i] = true;
+                    }
+                }
+            }
+            offset += sizeof(inotify_event) + event->len;
+        }
+        wait = SETTLE_MS;
+    }
+#else
+    // Poll the modification times, then give a changed file SETTLE_MS to finish being written
+    bool any = false;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    for (;;) {
+        for (size_t i = 0; i < files.size(); ++i) {
+            long long time = 0;
+            if (ModifiedTime(files[i].path, time) && time != files[i].modifiedTime) {
+                files[i].modifiedTime = time;
+                changed[i] = true;
+                any = true;
+            }
+        }
+        if (any || std::chrono::steady_clock::now() >= deadline) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(std::min(timeoutMs, 100)));
+    }
+    if (any) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(SETTLE_MS));
+        for (WatchedFile& file : files) {
+            ModifiedTime(file.path, file.modifiedTime);
+        }
+    }
+#endif
+
+    std::vector<std::string> paths;
+    for (size_t i = 0; i < files.size(); ++i) {
+        if (changed[i] && std::find(paths.begin(), paths.end(), files[i].path) == paths.end()) {
+            paths.push_back(files[i].path);
+        }
+    }
+    return paths;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// Reports which of a set of files changed on disk. Uses inotify on Linux, watching the files'
+// directories so editors that save by writing a new file and renaming it over the old one are seen too.
+// Elsewhere it compares modification times.
+class FileWatcher {
+public:
+    FileWatcher() = default;
+    ~FileWatcher();
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    bool Init(const std::vector<std::string>& paths);
+    void Destroy();
+
+    // Blocks up to timeoutMs for a change. Once something changed it waits for writes to settle, then
+    // returns every watched path (as given to Init) that changed; empty on timeout.
+    std::vector<std::string> Wait(int timeoutMs);
+
+private:
+    struct WatchedFile {
+        std::string path;
+        std::string directory;
+        std::string fileName;
+        int watch = -1;             // inotify watch descriptor of the directory
+        long long modifiedTime = 0; // Last seen modification time, without inotify
+    };
+
+    std::vector<WatchedFile> files;
+    int inotifyFd = -1;
+};
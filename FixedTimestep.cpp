@@ -0,0 +1,30 @@
+#include "FixedTimestep.h"
+#include <algorithm>
+#include <cmath>
+
+void FixedTimestep::Init(float stepTime, int maxSubsteps) {
+    fixedStep = std::max(stepTime, 0.0f);
+    currentStep = fixedStep;
+    maxSteps = std::max(maxSubsteps, 1);
+    accumulator = 0.0f;
+    droppedTime = 0.0;
+}
+
+int FixedTimestep::Advance(float frameTime) {
+    if (fixedStep <= 0.0f) {
+        currentStep = frameTime;
+        return 1;
+    }
+    accumulator += frameTime;
+    int steps = static_cast<int>(std::floor(accumulator / fixedStep));
+    if (steps > maxSteps) {
+        droppedTime += double(steps - maxSteps) * fixedStep;
+        steps = maxSteps;
+        accumulator = std::fmod(accumulator, fixedStep); // Keep the fraction, drop the whole steps beyond the cap
+    }
+    else {
+        accumulator -= steps * fixedStep;
+    }
+    accumulator = std::max(accumulator, 0.0f); // Rounding can leave a tiny negative remainder
+    return steps;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+// Decouples the simulation from the frame rate: every frame adds its wall-clock time to an accumulator
+// and the simulation advances in whole steps of a fixed length, as many as the accumulator covers. The
+// steps of a frame run as substeps of one dispatch. A long frame is capped at maxSubsteps, the time beyond
+// that is dropped rather than carried over, so a hitch slows the simulation down instead of snowballing.
+class FixedTimestep {
+public:
+    // stepTime 0 disables the accumulator: every frame is one step of the frame's own length
+    void Init(float stepTime, int maxSubsteps);
+
+    // Adds the frame's time, returns the number of steps to simulate this frame (possibly 0)
+    int Advance(float frameTime);
+
+    // Length of the steps returned by the last Advance()
+    float StepTime() const { return currentStep; }
+    // Simulation time dropped by the substep cap so far
+    double DroppedTime() const { return droppedTime; }
+
+private:
+    float fixedStep = 0.0f;
+    float currentStep = 0.0f;
+    float accumulator = 0.0f;
+    int maxSteps = 1;
+    double droppedTime = 0.0;
+};
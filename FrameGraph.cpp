@@ -0,0 +1,129 @@
+#include "FrameGraph.h"
+#include "GpuProfiler.h"
+#include "CpuProfiler.h"
+
+// Barrier bit that makes incoherent shader writes visible to this kind of access
+static GLbitfield BarrierBit(BufferAccess access) {
+    switch (access) {
+    case BufferAccess::ShaderStorageRead:
+    case BufferAccess::ShaderStorageWrite: return GL_SHADER_STORAGE_BARRIER_BIT;
+    case BufferAccess::AtomicCounterRead:
+    case BufferAccess::AtomicCounterWrite: return GL_ATOMIC_COUNTER_BARRIER_BIT;
+    case BufferAccess::UniformRead: return GL_UNIFORM_BARRIER_BIT;
+    case BufferAccess::VertexAttribRead: return GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT;
+    case BufferAccess::IndexRead: return GL_ELEMENT_ARRAY_BARRIER_BIT;
+    case BufferAccess::IndirectRead: return GL_COMMAND_BARRIER_BIT;
+    case BufferAccess::CopyRead:
+    case BufferAccess::CopyWrite: return GL_BUFFER_UPDATE_BARRIER_BIT;
+    case BufferAccess::ClientMappedRead: return GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT;
+    }
+    return 0;
+}
+
+// Only shader writes bypass the normal command ordering; copies and uploads are synchronized by GL itself
+static bool IsIncoherentWrite(BufferAccess access) {
+    return access == BufferAccess::ShaderStorageWrite || access == BufferAccess::AtomicCounterWrite;
+}
+
+// Every barrier bit a buffer can be consumed through
+static const GLbitfield ALL_BUFFER_BARRIERS =
+    GL_SHADER_STORAGE_BARRIER_BIT | GL_ATOMIC_COUNTER_BARRIER_BIT | GL_UNIFORM_BARRIER_BIT |
+    GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_ELEMENT_ARRAY_BARRIER_BIT | GL_COMMAND_BARRIER_BIT |
+    GL_BUFFER_UPDATE_BARRIER_BIT | GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT;
+
+FrameGraph::Resource FrameGraph::AddBuffer(const std::string& name) {
+    resourceNames.push_back(name);
+    resourceBuffers.push_back(0);
+    return static_cast<Resource>(resourceNames.size() - 1);
+}
+
+void FrameGraph::SetBuffer(Resource resource, GLuint buffer) {
+    resourceBuffers[resource] = buffer;
+}
+
+void FrameGraph::AddPass(const std::string& name, std::vector<Usage> usages, std::function<void()> execute, std::function<bool()> condition) {
+    Pass pass;
+    pass.name = name;
+    pass.usages = std::move(usages);
+    pass.execute = std::move(execute);
+    pass.condition = std::move(condition);
+    passes.push_back(std::move(pass));
+}
+
+void FrameGraph::Execute() {
+    for (Pass& pass : passes) {
+        pass.lastBarriers = 0;
+        pass.lastRan = !pass.condition || pass.condition();
+        if (!pass.lastRan) {
+            continue;
+        }
+
+        // Collect what this pass's accesses still need to see earlier shader writes
+        GLbitfield barriers = 0;
+        for (const Usage& usage : pass.usages) {
+            auto pending = pendingBarriers.find(resourceBuffers[usage.resource]);
+            if (pending != pendingBarriers.end()) {
+                barriers |= pending->second & BarrierBit(usage.access);
+            }
+        }
+
+        if (barriers) {
+            glMemoryBarrier(barriers);
+            // A barrier covers every buffer, not just the ones this pass uses
+            for (auto& pending : pendingBarriers) {
+                pending.second &= ~barriers;
+            }
+            pass.lastBarriers = barriers;
+        }
+
+        if (profiler) {
+            profiler->BeginPass(pass.name);
+        }
+        {
+            CpuZone zone(pass.name.c_str()); // Passes live as long as the graph
+            pass.execute();
+        }
+        if (profiler) {
+            profiler->EndPass();
+        }
+
+        for (const Usage& usage : pass.usages) {
+            if (IsIncoherentWrite(usage.access)) {
+                pendingBarriers[resourceBuffers[usage.resource]] = ALL_BUFFER_BARRIERS;
+            }
+        }
+    }
+}
+
+void FrameGraph::PrintLastFrame(std::ostream& out) const {
+    static const struct { GLbitfield bit; const char* name; } BARRIER_NAMES[] = {
+        { GL_SHADER_STORAGE_BARRIER_BIT, "SHADER_STORAGE" },
+        { GL_ATOMIC_COUNTER_BARRIER_BIT, "ATOMIC_COUNTER" },
+        { GL_UNIFORM_BARRIER_BIT, "UNIFORM" },
+        { GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT, "VERTEX_ATTRIB_ARRAY" },
+        { GL_ELEMENT_ARRAY_BARRIER_BIT, "ELEMENT_ARRAY" },
+        { GL_COMMAND_BARRIER_BIT, "COMMAND" },
+        { GL_BUFFER_UPDATE_BARRIER_BIT, "BUFFER_UPDATE" },
+        { GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT, "CLIENT_MAPPED_BUFFER" },
+    };
+
+    for (const Pass& pass : passes) {
+        out << pass.name << ": ";
+        if (!pass.lastRan) {
+            out << "skipped\n";
+            continue;
+        }
+        if (!pass.lastBarriers) {
+            out << "no barrier\n";
+            continue;
+        }
+        const char* separator = "";
+        for (const auto& barrier : BARRIER_NAMES) {
+            if (pass.lastBarriers & barrier.bit) {
+                out << separator << barrier.name;
+                separator = " | ";
+            }
+        }
+        out << '\n';
+    }
+}
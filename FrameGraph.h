@@ -0,0 +1,72 @@
+#pragma once
+#include <glew.h>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class GpuProfiler;
+
+// How a pass touches a buffer
+enum class BufferAccess {
+    ShaderStorageRead,   // SSBO read in a shader
+    ShaderStorageWrite,  // SSBO write in a shader (incoherent, needs a barrier before the next consumer)
+    AtomicCounterRead,   // Atomic counter buffer read in a shader
+    AtomicCounterWrite,  // Atomic counter buffer write in a shader (incoherent)
+    UniformRead,         // Uniform buffer
+    VertexAttribRead,    // Vertex fetch
+    IndexRead,           // Element array
+    IndirectRead,        // glDraw*Indirect / glDispatchComputeIndirect arguments
+    CopyRead,            // glCopyBufferSubData source, glGetBufferSubData
+    CopyWrite,           // glCopyBufferSubData destination, glBufferSubData, glClearBufferData, glMapBufferRange writes
+    ClientMappedRead,    // CPU read through a persistent mapping
+};
+
+// Declarative list of the frame's passes. Each pass declares the buffers it reads and writes;
+// Execute() runs the passes in order and issues, before each one, exactly the glMemoryBarrier bits
+// needed to make earlier incoherent shader writes visible to the way the pass consumes them.
+// Which writes are still unsynchronized is tracked per GL buffer across frames, so a barrier
+// issued for one consumer is not repeated for the next consumer of the same kind.
+class FrameGraph {
+public:
+    typedef int Resource;
+
+    struct Usage {
+        Resource resource;
+        BufferAccess access;
+    };
+
+    // Named slot for a buffer, bound to a GL buffer object per frame (ping-pong buffers swap every frame)
+    Resource AddBuffer(const std::string& name);
+    void SetBuffer(Resource resource, GLuint buffer);
+
+    // condition may be empty; when it returns false the pass is skipped for the frame and needs no barriers
+    void AddPass(const std::string& name, std::vector<Usage> usages, std::function<void()> execute, std::function<bool()> condition = nullptr);
+
+    // Times every pass on the GPU, null to stop
+    void SetProfiler(GpuProfiler* gpuProfiler) { profiler = gpuProfiler; }
+
+    void Execute();
+
+    // Barriers issued by the last Execute(), one line per pass
+    void PrintLastFrame(std::ostream& out) const;
+
+private:
+    struct Pass {
+        std::string name;
+        std::vector<Usage> usages;
+        std::function<void()> execute;
+        std::function<bool()> condition;
+        GLbitfield lastBarriers = 0; // Issued before the pass in the last frame
+        bool lastRan = false;
+    };
+
+    std::vector<std::string> resourceNames;
+    std::vector<GLuint> resourceBuffers;
+    std::vector<Pass> passes;
+    GpuProfiler* profiler = nullptr;
+
+    // Barrier bits a buffer still needs before each kind of consumer sees its last shader writes
+    std::unordered_map<GLuint, GLbitfield> pendingBarriers;
+};
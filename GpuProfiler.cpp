@@ -0,0 +1,185 @@
+#include "GpuProfiler.h"
+#include "Benchmark.h"
+#include <iostream>
+#include <algorithm>
+#include <limits>
+
+static const size_t MAX_TRACE_EVENTS = 200000; // Keeps long runs bounded, the stats still see every frame
+
+GpuProfiler::~GpuProfiler() {
+    Destroy();
+}
+
+bool GpuProfiler::Init(int latency) {
+    GLint counterBits = 0;
+    glGetQueryiv(GL_TIMESTAMP, GL_QUERY_COUNTER_BITS, &counterBits);
+    if (counterBits == 0) {
+        std::cerr << "ERROR::GPU_PROFILER::NO_TIMESTAMPS" << std::endl;
+        return false;
+    }
+    readLatency = std::max(latency, 1);
+    slots.resize(readLatency + 2); // The frames waiting out the latency, the one being recorded and one spare
+    return true;
+}
+
+void GpuProfiler::Destroy() {
+    for (Slot& slot : slots) {
+        if (!slot.queries.empty()) {
+            glDeleteQueries(static_cast<GLsizei>(slot.queries.size()), slot.queries.data());
+        }
+    }
+    slots.clear();
+    current = nullptr;
+    pendingSlots = 0;
+}
+
+GLuint GpuProfiler::NextQuery(Slot& slot) {
+    if (slot.usedQueries == slot.queries.size()) {
+        GLuint query = 0;
+        glGenQueries(1, &query);
+        slot.queries.push_back(query);
+    }
+    return slot.queries[slot.usedQueries++];
+}
+
+size_t GpuProfiler::PassIndex(const std::string& name) {
+    for (size_t i = 0; i < passStats.size(); ++i) {
+        if (passStats[i].name == name) {
+            return i;
+        }
+    }
+    passStats.push_back({ name, {} });
+    return passStats.size() - 1;
+}
+
+void GpuProfiler::BeginFrame(int frame) {
+    current = nullptr;
+    if (!Enabled()) {
+        return;
+    }
+    if (pendingSlots == slots.size()) {
+        ++droppedFrames; // GPU is behind, skip this frame rather than wait
+        return;
+    }
+    current = &slots[nextSlot];
+    current->frame = frame;
+    current->passes.clear();
+    current->usedQueries = 0;
+    nextSlot = (nextSlot + 1) % slots.size();
+    ++pendingSlots;
+}
+
+void GpuProfiler::BeginPass(const std::string& name) {
+    if (!current) {
+        return;
+    }
+    PassQuery pass;
+    pass.pass = PassIndex(name);
+    pass.begin = NextQuery(*current);
+    pass.end = NextQuery(*current);
+    glQueryCounter(pass.begin, GL_TIMESTAMP);
+    current->passes.push_back(pass);
+    current->recording = true;
+}
+
+void GpuProfiler::EndPass() {
+    if (!current || !current->recording) {
+        return;
+    }
+    glQueryCounter(current->passes.back().end, GL_TIMESTAMP);
+    current->recording = false;
+}
+
+void GpuProfiler::EndFrame() {
+    current = nullptr;
+}
+
+void GpuProfiler::Poll(int frame) {
+    while (pendingSlots > 0) {
+        Slot& slot = slots[oldestSlot];
+        if (&slot == current || frame - slot.frame < readLatency) {
+            return; // Too recent, leave it for a later frame
+        }
+        if (!slot.passes.empty()) {
+            // Queries complete in submission order, the last one being available covers the frame
+            GLuint available = GL_FALSE;
+            glGetQueryObjectuiv(slot.passes.back().end, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available) {
+                return;
+            }
+            Read(slot);
+        }
+        slot.frame = -1;
+        oldestSlot = (oldestSlot + 1) % slots.size();
+        --pendingSlots;
+    }
+}
+
+void GpuProfiler::Finish() {
+    if (pendingSlots == 0) {
+        return;
+    }
+    glFinish();
+    Poll(std::numeric_limits<int>::max()); // Every pending frame counts as old enough
+}
+
+void GpuProfiler::Read(Slot& slot) {
+    for (const PassQuery& pass : slot.passes) {
+        GLuint64 begin = 0, end = 0;
+        glGetQueryObjectui64v(pass.begin, GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(pass.end, GL_QUERY_RESULT, &end);
+        end = std::max(end, begin);
+        passStats[pass.pass].durations.push_back((end - begin) / 1e6);
+        if (trace.size() < MAX_TRACE_EVENTS) {
+            trace.push_back({ pass.pass, slot.frame, begin, end });
+        }
+    }
+}
+
+void GpuProfiler::WriteCsv(std::ostream& out) const {
+    out << "pass,samples,mean_ms,min_ms,p50_ms,p95_ms,max_ms\n";
+    for (const PassStats& stats : passStats) {
+        std::vector<double> sorted = stats.durations;
+        std::sort(sorted.begin(), sorted.end());
+        double total = 0.0;
+        for (double duration : sorted) {
+            total += duration;
+        }
+        out << stats.name << ',' << sorted.size() << ','
+            << (sorted.empty() ? 0.0 : total / sorted.size()) << ','
+            << (sorted.empty() ? 0.0 : sorted.front()) << ','
+            << Percentile(sorted, 50.0) << ',' << Percentile(sorted, 95.0) << ','
+            << (sorted.empty() ? 0.0 : sorted.back()) << '\n';
+    }
+}
+
+void GpuProfiler::WriteChromeTrace(std::ostream& out) const {
+    GLuint64 origin = trace.empty() ? 0 : trace.front().begin;
+    for (const TraceEvent& event : trace) {
+        origin = std::min(origin, event.begin);
+    }
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+        << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"GPU\"}}";
+    for (const TraceEvent& event : trace) {
+        // Pass names are identifiers, nothing to escape
+        out << ",\n{\"name\":\"" << passStats[event.pass].name << "\",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":1,\"tid\":1"
+            << ",\"ts\":" << (event.begin - origin) / 1000.0 << ",\"dur\":" << (event.end - event.begin) / 1000.0
+            << ",\"args\":{\"frame\":" << event.frame << "}}";
+    }
+    out << "\n]}\n";
+}
+
+void GpuProfiler::Report(std::ostream& out) const {
+    out << "=== GPU passes ===\n";
+    for (const PassStats& stats : passStats) {
+        std::vector<double> sorted = stats.durations;
+        std::sort(sorted.begin(), sorted.end());
+        double total = 0.0;
+        for (double duration : sorted) {
+            total += duration;
+        }
+        out << "gpu_" << stats.name << "_ms_mean: " << (sorted.empty() ? 0.0 : total / sorted.size()) << "\n"
+            << "gpu_" << stats.name << "_ms_p95: " << Percentile(sorted, 95.0) << "\n";
+    }
+    out << "gpu_frames_dropped: " << droppedFrames << std::endl;
+}
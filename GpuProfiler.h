@@ -0,0 +1,76 @@
+#pragma once
+#include <glew.h>
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// GPU time of every frame graph pass, measured with GL_TIMESTAMP queries around each pass.
+// The queries of a frame are read back readLatency frames later, once the GPU has long finished
+// them, so the CPU never waits on a result; when the GPU falls further behind than the ring of
+// query sets covers, that frame is not measured. Results are aggregated per pass and can be
+// exported as CSV (one row per pass) or as a Chrome trace (chrome://tracing, ui.perfetto.dev).
+class GpuProfiler {
+public:
+    ~GpuProfiler();
+
+    // False if the implementation has no timestamp counter
+    bool Init(int readLatency);
+    void Destroy();
+    bool Enabled() const { return !slots.empty(); }
+
+    void BeginFrame(int frame);
+    void BeginPass(const std::string& name);
+    void EndPass();
+    void EndFrame();
+
+    // Reads back the frames that are old enough and whose queries are available, never waits
+    void Poll(int frame);
+    // Waits for the GPU and reads every frame still pending, once after the last frame
+    void Finish();
+
+    // pass,samples,mean_ms,min_ms,p50_ms,p95_ms,max_ms
+    void WriteCsv(std::ostream& out) const;
+    // Complete ("X") events on one GPU track, microseconds since the first measured frame
+    void WriteChromeTrace(std::ostream& out) const;
+    // "gpu_<pass>_ms_mean/p95: " lines in the benchmark report style
+    void Report(std::ostream& out) const;
+
+private:
+    struct PassQuery {
+        size_t pass;   // Index into passStats
+        GLuint begin;  // Timestamp queries
+        GLuint end;
+    };
+    struct Slot {
+        std::vector<GLuint> queries; // Pool, grows to the number of passes in a frame
+        std::vector<PassQuery> passes;
+        size_t usedQueries = 0;
+        int frame = -1;              // -1 when free
+        bool recording = false;
+    };
+    struct PassStats {
+        std::string name;
+        std::vector<double> durations; // Milliseconds, one per measured frame the pass ran in
+    };
+    struct TraceEvent {
+        size_t pass;
+        int frame;
+        GLuint64 begin; // Nanoseconds
+        GLuint64 end;
+    };
+
+    GLuint NextQuery(Slot& slot);
+    size_t PassIndex(const std::string& name);
+    void Read(Slot& slot);
+
+    std::vector<Slot> slots;
+    std::vector<PassStats> passStats;
+    std::vector<TraceEvent> trace;
+    size_t nextSlot = 0;
+    size_t oldestSlot = 0;
+    size_t pendingSlots = 0;
+    int readLatency = 3;
+    int droppedFrames = 0;
+    Slot* current = nullptr;    // Slot of the frame being recorded, null when the frame is not measured
+};
@@ -4,43 +4,160 @@
 #include <iostream>
 #include <vector>
 #include <string>
-#include <fstream>
-#include <sstream>
 #include <chrono>
-#include <random>
-
-// Constants
-const int NUM_PARTICLES = 1000; // Number of particles
-const int WORK_GROUP_SIZE = 10; // Ensure this matches the compute shader's local_size_x
-
-// Particle structure
-struct Particle {
-    glm::vec2 position; // Add position attribute
-    glm::vec2 velocity; // Add velocity attribute
-    glm::vec4 color;    // Add color attribute
-    float age;          // Add age attribute
-    float lifeTime;     // Add lifetime attribute
-};
-
-std::vector<Particle> particles(NUM_PARTICLES); // Vector of particles
+#include <algorithm>
+#include <functional>
+#include <fstream>
+#include "AppConfig.h"
+#include "Benchmark.h"
+#include "Particle.h"
+#include "ParticleInspector.h"
+#include "ComputeDispatch.h"
+#include "ShaderProgram.h"
+#include "ParticleStorage.h"
+#include "ParticlePacking.h"
+#include "FrameGraph.h"
+#include "CpuSimulation.h"
+#include "Validation.h"
+#include "ParticleRandom.h"
+#include "ParticleLists.h"
+#include "ParticleEmitters.h"
+#include "CurlNoiseField.h"
+#include "RadixSort.h"
+#include "SortBenchmark.h"
+#include "ShaderReloader.h"
+#include "ProgramBinaryCache.h"
+#include "ShaderVariantCache.h"
+#include "ShaderSourceFile.h"
+#include "GpuProfiler.h"
+#include "CpuProfiler.h"
+#include "FixedTimestep.h"
+#include "StartupTimeline.h"
+#include "TaskGraph.h"
+#include "ThreadPool.h"
+
+std::vector<Particle> particles; // Vector of particles, sized from the command line
 
 // Function prototypes
-std::string ReadShaderFile(const std::string& shaderPath);
-GLuint CompileShader(const std::string& source, GLenum shaderType);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
+
+// State of particle id before the first frame, a pure function of its id so particles can be generated in any order
+static Particle InitialParticle(uint32_t id, uint32_t seed, const std::vector<EmitterParams>& emitters) {
+    Particle particle = {};
+    if (!emitters.empty()) {
+        // The emitters share the particles round robin, each starts its first life at its emitter
+        particle.emitter = id % static_cast<uint32_t>(emitters.size());
+        const EmitterParams& emitter = emitters[particle.emitter];
+        particle.position = emitter.position;
+        particle.velocity = EmitterLaunchVelocity(emitter, seed, id, 0);
+        particle.color = EmitterColor(emitter, seed, id, 0);
+        particle.age = 0.0f;
+        particle.respawnCount = 0;
+        particle.lifeTime = EmitterLifetime(emitter, seed, id, 0);
+        return particle;
+    }
+    glm::uvec3 colorBits = ParticleRandom(seed, id, PARTICLE_RANDOM_INIT_COUNTER);
+
+    particle.position = glm::vec2(20,20); // Start at the mouse position
+    particle.velocity = ParticleLaunchVelocity(seed, id); // Random direction, respawns redraw it once forces act
+    particle.color = glm::vec4(RandomUnit(colorBits.x), RandomUnit(colorBits.y), RandomUnit(colorBits.z), 1.0f); // Random color
+
+    particle.age = 0.0f; // Start at age 0
+    particle.respawnCount = 0;
+    particle.lifeTime = ParticleLifetime(seed, id, 0); // Assign random lifetime
+    return particle;
+}
 
 // Global variable for mouse position
 glm::vec2 mousePos;
+bool cpuCaptureRequested = false; // Set by F9, the loop starts a CPU capture at the next frame
+
+int main(int argc, char** argv) {
+    AppConfig config;
+    if (!ParseCommandLine(argc, argv, config)) {
+        PrintUsage(argv[0]);
+        return -1;
+    }
+
+    // A capture starting at frame 0 also covers the startup
+    CpuProfiler::SetThreadName("main");
+    if (!config.cpuProfilePath.empty() && config.cpuProfileStart == 0) {
+        CpuProfiler::BeginCapture();
+    }
+    const int64_t startupBegin = CpuProfiler::Now();
+    StartupTimeline startupTimeline(startupBegin);
+
+    // Release builds carry their shaders, editing them needs the files
+    if (config.shadersFromDisk || config.hotReload) {
+        SetShaderSourceMode(ShaderSourceMode::Disk);
+    }
+
+    const uint32_t seed = static_cast<uint32_t>(config.seed);
+    const bool useEmitters = config.emitterCount > 0;
+    std::vector<EmitterParams> emitterParams; // Host side of the emitter table, empty without emitters
+    if (useEmitters) {
+        emitterParams = DefaultEmitters(size_t(config.emitterCount), config.emitRate, seed);
+    }
+
+    // Startup work that needs no context runs on workers while the main thread creates it: the shader
+    // files are read and expanded, the particles generated and checked. The main thread only waits for a
+    // task right before it uses the result.
+    std::unique_ptr<ThreadPool> startupPool(new ThreadPool(static_cast<unsigned>(config.cpuThreads))); // Data-parallel loops of the tasks
+    TaskGraph startupTasks(2); // Declared after what its tasks use, its destructor waits for them
+    TaskGraph::Task loadShadersTask = startupTasks.Add({}, [&]() {
+        StartupPhase phase(startupTimeline, "load shader files");
+        std::vector<std::string> paths = { "vertex_shader.glsl", "fragment_shader.glsl" };
+        if (config.backend == SimulationBackend::Gpu || config.sortParticles) {
+            paths.push_back("compute_shader.glsl");
+        }
+        if (config.emitRate > 0.0f) {
+            paths.push_back("list_prepare_shader.glsl");
+        }
+        if (config.sortParticles || config.sortBenchmarkKeys > 0) {
+            paths.push_back("radix_sort_shader.glsl");
+        }
+        return PreloadShaderFiles(paths);
+    });
+
+    // Every random value comes from the RNG the shader uses so a seed reproduces the run, and each particle
+    // only depends on its id, so the particles are generated in parallel
+    TaskGraph::Task generateTask = -1, packingCheckTask = -1;
+    if (config.sortBenchmarkKeys == 0) {
+        generateTask = startupTasks.Add({}, [&]() {
+            StartupPhase phase(startupTimeline, "generate particles");
+            particles.resize(config.particleCount);
+            startupPool->ParallelFor(particles.size(), 16384, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                    particles[i] = InitialParticle(static_cast<uint32_t>(i), seed, emitterParams);
+                }
+            });
+            return true;
+        });
+
+        // The packed layout trades precision for bandwidth, make sure it stays within what its formats promise
+        if (config.particleLayout == ParticleLayout::Packed) {
+            packingCheckTask = startupTasks.Add({ generateTask }, [&]() {
+                StartupPhase phase(startupTimeline, "check packing");
+                return CheckPackingError(MeasurePackingError(particles, seed, useEmitters ? &emitterParams : nullptr), PackingErrorBudget());
+            });
+        }
+    }
 
-int main() {
     // Initialize GLFW
+    std::unique_ptr<StartupPhase> contextPhase(new StartupPhase(startupTimeline, "create context"));
     if (!glfwInit()) {
         std::cerr << "Failed to initialize GLFW" << std::endl;
         return -1;
     }
 
+    // Headless runs still need a context, so create the window but never show it
+    if (config.headless) {
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    }
+
     // Create a windowed mode window and its OpenGL context
-    GLFWwindow* window = glfwCreateWindow(640, 480, "Compute Shader Particle System", NULL, NULL);
+    GLFWwindow* window = glfwCreateWindow(config.windowWidth, config.windowHeight, "Compute Shader Particle System", NULL, NULL);
     if (!window) {
         std::cerr << "Failed to create GLFW window" << std::endl;
         glfwTerminate();
@@ -57,111 +174,358 @@ int main() {
         return -1;
     }
 
-    // Set the mouse callback
+    glfwSwapInterval(config.vsync ? 1 : 0); // Vsync would cap benchmark throughput at the refresh rate
+    contextPhase.reset();
+    {
+        StartupPhase phase(startupTimeline, "wait for shader files");
+        startupTasks.Wait(loadShadersTask); // A file that failed to load is read again, and reported, by its build
+    }
+
+    // Linked programs are cached on disk so warm starts skip compiling
+    ProgramBinaryCache programCache;
+    if (!config.shaderCacheDirectory.empty() && programCache.Init(config.shaderCacheDirectory)) {
+        ShaderProgram::SetBinaryCache(&programCache);
+    }
+    ShaderVariantCache shaderVariants; // One program per define set, shared by the passes asking for it
+    const bool parallelCompile = ShaderProgram::EnableParallelCompile();
+
+    // The sort microbenchmark only needs the context
+    if (config.sortBenchmarkKeys > 0) {
+        const int sortIterations = 10;
+        bool passed = RunSortBenchmark(config.sortBenchmarkKeys, sortIterations, static_cast<uint32_t>(config.seed), std::cout);
+        glfwTerminate();
+        return passed ? 0 : 1;
+    }
+
+    // Set the mouse and key callbacks
     glfwSetCursorPosCallback(window, mouse_callback);
+    glfwSetKeyCallback(window, key_callback);
+
+    // Offscreen render target for headless mode, the hidden window's default framebuffer is not guaranteed to be rendered
+    GLuint offscreenFBO = 0, offscreenColor = 0;
+    if (config.headless) {
+        glGenRenderbuffers(1, &offscreenColor); // Create color attachment
+        glBindRenderbuffer(GL_RENDERBUFFER, offscreenColor);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, config.windowWidth, config.windowHeight);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        glGenFramebuffers(1, &offscreenFBO); // Create FBO
+        glBindFramebuffer(GL_FRAMEBUFFER, offscreenFBO);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, offscreenColor);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cerr << "ERROR::FRAMEBUFFER::INCOMPLETE" << std::endl;
+            glfwTerminate();
+            return -1;
+        }
+        glViewport(0, 0, config.windowWidth, config.windowHeight); // FBO stays bound for the whole run
+    }
 
     // Using std::chrono for high-precision time
     auto lastFrameTime = std::chrono::high_resolution_clock::now();
     float deltaTime = 0.0f;
 
-    std::random_device rd;  // Obtain a seed from a random device (e.g., entropy source)
-    std::mt19937 eng(rd()); // Initialize Mersenne Twister with the seed
-
-    std::uniform_real_distribution<> distr(-1.0, 1.0); // Range for random direction
-    std::uniform_real_distribution<> colorDistr(0.0, 1.0); // Range for random color
-    std::uniform_real_distribution<float> lifeTimeDistr(1.5f, 3.0f); // Lifetime between 1 and 5 seconds
-
-    // Initialize particles
-    for (auto& particle : particles) {
-        float dirX = distr(eng); // Random direction
-        float dirY = distr(eng);  // Random direction
-        glm::vec2 direction = glm::normalize(glm::vec2(dirX, dirY));
-
-        particle.position = glm::vec2(20,20); // Start at the mouse position
-
-        // Cast to float to ensure the whole expression is treated as a float
-        float randomSpeedFactor = 0.2f + 0.005f;
-        particle.velocity = direction * randomSpeedFactor;
-        particle.color = glm::vec4(colorDistr(eng), colorDistr(eng), colorDistr(eng), 1.0f); // Random color
-
-        particle.age = 0.0f; // Start at age 0
-        particle.lifeTime = lifeTimeDistr(eng); // Assign random lifetime
+    // The simulation advances in fixed steps, every frame runs the ones its time covers as substeps of one dispatch
+    FixedTimestep timestep;
+    timestep.Init(config.simulationStep, config.maxSubsteps);
+    int substeps = 0;
+    const glm::vec2 gravity(0.0f, -config.gravity);
+    const bool useCurlNoise = config.curlNoise > 0.0f;
+    const bool dynamicVelocity = config.gravity != 0.0f || useEmitters || useCurlNoise; // Emitters launch every life with a velocity of its own, the field is a force
+    double simulatedTime = 0.0; // Sum of the steps simulated so far, the force field moves with it
+
+    const GLsizei particleCount = static_cast<GLsizei>(config.particleCount);
+    ParticleStorage particleStorage; // Filled once the programs are submitted
+
+    // Every particle belongs to one emitter of the table and respawns from its entry, all in the same dispatch
+    ParticleEmitters emitters;
+    const std::vector<EmitterParams>* emitterTable = nullptr; // Host copy, null without emitters
+    if (useEmitters) {
+        if (!emitters.Init(emitterParams)) {
+            glfwTerminate();
+            return -1;
+        }
+        emitterTable = &emitters.Params(); // Authoritative from here on, the first emitter follows the mouse
     }
 
-    // Load and compile compute shader
-    std::string computeShaderSource = ReadShaderFile("compute_shader.glsl"); // Read compute shader file
-    GLuint computeShader = CompileShader(computeShaderSource, GL_COMPUTE_SHADER); // Compile compute shader
+    // Work group size comes from the command line, clamped to what the device supports
+    GLuint localSize = std::min<GLuint>(config.localSize, MaxComputeLocalSize());
+    DispatchSize dispatchSize;
+    if (!ComputeDispatchSize(size_t(particleCount), localSize, dispatchSize)) {
+        glfwTerminate();
+        return -1;
+    }
 
-    GLint success; // Check for shader compile errors
-    GLchar infoLog[512]; // Check for shader compile errors
-    glGetShaderiv(computeShader, GL_COMPILE_STATUS, &success); 
-    if (!success) { 
-        glGetShaderInfoLog(computeShader, 512, NULL, infoLog);
-        std::cerr << "ERROR::COMPUTESHADER::COMPILATION_FAILED\n" << infoLog << std::endl;
+    // Each stream, list and table of the compute variants is a storage block at a fixed binding, the richest
+    // flag combinations need more than some drivers allow; refuse them here rather than with a link error
+    const bool useLists = config.emitRate > 0.0f;
+    std::vector<GLuint> extraBindings; // Blocks of the lists and the emitter table, shared by the variants
+    if (useLists) {
+        extraBindings = ParticleLists::StorageBindings();
+    }
+    if (useEmitters) {
+        std::vector<GLuint> emitterBindings = ParticleEmitters::StorageBindings();
+        extraBindings.insert(extraBindings.end(), emitterBindings.begin(), emitterBindings.end());
+    }
+    std::vector<GLuint> simulateBindings = ParticleStorage::StreamBindings(config.particleLayout, config.pingPong, dynamicVelocity, useEmitters);
+    simulateBindings.insert(simulateBindings.end(), extraBindings.begin(), extraBindings.end());
+    std::vector<GLuint> sortKeysBindings = ParticleStorage::StreamBindings(config.particleLayout, false, dynamicVelocity, useEmitters);
+    sortKeysBindings.insert(sortKeysBindings.end(), extraBindings.begin(), extraBindings.end());
+    std::vector<GLuint> sortBindings = RadixSort::SortKeyBindings();
+    sortKeysBindings.insert(sortKeysBindings.end(), sortBindings.begin(), sortBindings.end());
+    if ((config.backend == SimulationBackend::Gpu && !ComputeStorageBlocksFit("COMPUTE", simulateBindings)) ||
+        (config.sortParticles && !ComputeStorageBlocksFit("SORT_KEYS", sortKeysBindings))) {
+        std::cerr << "Leave out some of --ping-pong, --emit-rate, --emitters and --sort, or use --layout aos or packed" << std::endl;
+        glfwTerminate();
+        return -1;
     }
 
-    GLuint computeShaderProgram = glCreateProgram(); // Create compute shader program
-    glAttachShader(computeShaderProgram, computeShader); // Attach compute shader
-    glLinkProgram(computeShaderProgram); // Link compute shader program
+    // Every program the loop uses, described by its files and defines. Submitting stores the variant
+    // cache's program in *program, once built resolve re-reads the handles the loop uses; with --hot-reload the
+    // same description rebuilds the program whenever one of its files, or a file they include, changes.
+    struct ProgramSetup {
+        ShaderProgram** program;
+        std::string name;
+        std::vector<ShaderFileStage> stages;
+        std::function<void()> resolve;
+    };
+    std::vector<ProgramSetup> programSetups;
+    auto programBuildStart = std::chrono::high_resolution_clock::now();
+    auto setSeed = [&](const ShaderProgram& program) {
+        if (program.HasUniform("seed")) { // Variants that neither respawn nor derive the lifetime drop it
+            program.GetUniform<GLuint>("seed").Set(seed); // Never changes, program uniforms keep their value
+        }
+    };
+
+    // The compute program is only needed, and only has to compile, when the GPU runs the update
+    ShaderProgram* computeProgram = nullptr;
+    Uniform<glm::vec2> mousePosUniform;
+    Uniform<float> deltaTimeUniform;
+    Uniform<GLuint> substepsUniform;
+    Uniform<float> fieldSliceUniform;
+    ParticleLists particleLists;
+    ShaderProgram* prepareProgram = nullptr;
+    ShaderProgram* emitProgram = nullptr;
+    Uniform<GLuint> emitRequestUniform;
+    Uniform<float> simulatedTimeUniform;
+    if (config.backend == SimulationBackend::Gpu) {
+        ShaderDefines computeDefines = ParticleStorage::SimulationDefines(config.particleLayout, particleCount, config.pingPong, dynamicVelocity);
+        computeDefines.Set("LOCAL_SIZE_X", std::to_string(localSize)).Set(ParticleIntegratorDefine(config.integrator));
+        if (useLists) {
+            computeDefines.Merge(ParticleLists::Defines());
+        }
+        if (useEmitters) {
+            computeDefines.Merge(ParticleEmitters::Defines(emitters.Count()));
+        }
+        if (useCurlNoise) {
+            computeDefines.Merge(CurlNoiseField::Defines());
+        }
+        programSetups.push_back({ &computeProgram, "COMPUTE", { { GL_COMPUTE_SHADER, "compute_shader.glsl", computeDefines } },
+            [&]() {
+                // Respawning needs the mouse position unless the emitter table holds the positions, in pooled mode only the emit pass respawns
+                if (!useLists && !useEmitters) {
+                    mousePosUniform = computeProgram->GetUniform<glm::vec2>("mousePos");
+                }
+                deltaTimeUniform = computeProgram->GetUniform<float>("deltaTime");
+                substepsUniform = computeProgram->GetUniform<GLuint>("substeps");
+                if (dynamicVelocity) {
+                    computeProgram->GetUniform<glm::vec2>("gravity").Set(gravity); // Constant for the run
+                }
+                if (useCurlNoise) {
+                    computeProgram->GetUniform<float>("fieldStrength").Set(config.curlNoise);
+                    fieldSliceUniform = computeProgram->GetUniform<float>("fieldSlice");
+                }
+                setSeed(*computeProgram);
+                particleStorage.ResolveBlocks(*computeProgram);
+                emitters.ResolveBlocks(*computeProgram); // Fixed bindings, each program adds the blocks it uses
+            } });
+
+        // Pooled mode: a one-thread pass sizing the frame's dispatches, and the emit variant of the update
+        if (useLists) {
+            if (!particleLists.Init(particleCount)) {
+                glfwTerminate();
+                return -1;
+            }
+            ShaderDefines prepareDefines;
+            prepareDefines.Set("LOCAL_SIZE_X", std::to_string(localSize) + "u").Set("MAX_GROUPS_X", std::to_string(MaxComputeGroupCountX()) + "u");
+            if (useEmitters) {
+                prepareDefines.Merge(ParticleEmitters::Defines(emitters.Count())); // Each emitter requests its own share at its rate
+            }
+            programSetups.push_back({ &prepareProgram, "PREPARE", { { GL_COMPUTE_SHADER, "list_prepare_shader.glsl", prepareDefines } },
+                [&]() {
+                    if (useEmitters) {
+                        simulatedTimeUniform = prepareProgram->GetUniform<float>("simulatedTime");
+                        emitters.ResolveBlocks(*prepareProgram);
+                    }
+                    else {
+                        emitRequestUniform = prepareProgram->GetUniform<GLuint>("emitRequest");
+                    }
+                } });
+            programSetups.push_back({ &emitProgram, "EMIT", { { GL_COMPUTE_SHADER, "compute_shader.glsl", ShaderDefines(computeDefines).Set("EMIT_PASS") } },
+                [&]() {
+                    if (!useEmitters) {
+                        mousePosUniform = emitProgram->GetUniform<glm::vec2>("mousePos");
+                    }
+                    setSeed(*emitProgram);
+                    particleLists.ResolveBlocks(*emitProgram); // Same bindings in all programs using the lists
+                    emitters.ResolveBlocks(*emitProgram);
+                } });
+        }
+    }
 
-    glGetProgramiv(computeShaderProgram, GL_LINK_STATUS, &success); // Check for linking errors
-    if (!success) {
-        glGetProgramInfoLog(computeShaderProgram, 512, NULL, infoLog);
-        std::cerr << "ERROR::COMPUTEPROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+    // Back-to-front draw order: a variant of the compute shader writes a key per drawn particle,
+    // the radix sort orders the particle indices by it and the draw reads them as its index buffer
+    RadixSort particleSort;
+    ShaderProgram* sortKeysProgram = nullptr;
+    BufferBlock sortKeysBlock, sortValuesBlock;
+    const int SORT_KEY_BITS = 16; // SORT_KEY_MAX in compute_shader.glsl
+    if (config.sortParticles) {
+        if (!particleSort.Init(particleCount, shaderVariants)) {
+            glfwTerminate();
+            return -1;
+        }
+        ShaderDefines sortKeysDefines = ParticleStorage::LayoutDefines(config.particleLayout, particleCount);
+        sortKeysDefines.Set("LOCAL_SIZE_X", std::to_string(localSize)).Set("SORT_KEYS_PASS");
+        if (useLists) {
+            sortKeysDefines.Merge(ParticleLists::Defines());
+        }
+        if (useEmitters) {
+            sortKeysDefines.Merge(ParticleEmitters::Defines(emitters.Count())); // Derived lifetimes come from the emitters' ranges
+        }
+        programSetups.push_back({ &sortKeysProgram, "SORT_KEYS", { { GL_COMPUTE_SHADER, "compute_shader.glsl", sortKeysDefines } },
+            [&]() {
+                setSeed(*sortKeysProgram);
+                particleStorage.ResolveReadBlocks(*sortKeysProgram);
+                emitters.ResolveBlocks(*sortKeysProgram);
+                sortKeysBlock = sortKeysProgram->GetStorageBlock("SortKeys");
+                sortValuesBlock = sortKeysProgram->GetStorageBlock("SortValues");
+            } });
     }
 
-    // Load and compile vertex and fragment shaders
-    std::string vertexShaderSource = ReadShaderFile("vertex_shader.glsl");
-    std::string fragmentShaderSource = ReadShaderFile("fragment_shader.glsl");
-    GLuint vertexShader = CompileShader(vertexShaderSource, GL_VERTEX_SHADER);
+    // Vertex and fragment shaders
+    ShaderProgram* renderProgram = nullptr;
+    programSetups.push_back({ &renderProgram, "RENDER", { { GL_VERTEX_SHADER, "vertex_shader.glsl", ShaderDefines() }, { GL_FRAGMENT_SHADER, "fragment_shader.glsl", ShaderDefines() } },
+        []() {} });
+
+    // Submit every build before the particles are uploaded; with parallel compile the driver compiles
+    // while that runs, so startup waits for the slowest program instead of their sum
+    {
+        StartupPhase phase(startupTimeline, "submit programs");
+        for (const ProgramSetup& setup : programSetups) {
+            *setup.program = shaderVariants.Request(setup.name, setup.stages);
+            if (!*setup.program) {
+                glfwTerminate();
+                return -1;
+            }
+        }
+        ReleasePreloadedShaders(); // Rebuilds read the files again
+    }
 
-    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success); // Check for shader compile errors
-    if (!success) {
-        glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
-        std::cerr << "ERROR::VERTEXSHADER::COMPILATION_FAILED\n" << infoLog << std::endl;
+    // Bake the force field while the driver compiles, slices baked by an earlier run come from the cache
+    CurlNoiseField curlNoise;
+    float fieldSlice = 0.0f; // Where the frame's time falls in the field's ring of slices
+    if (useCurlNoise) {
+        StartupPhase phase(startupTimeline, "bake force field");
+        CurlNoiseSettings fieldSettings;
+        fieldSettings.resolution = config.curlResolution;
+        fieldSettings.frequency = config.curlScale;
+        fieldSettings.seed = seed;
+        if (!curlNoise.Init(fieldSettings, config.curlPeriod, config.fieldCacheDirectory, config.cpuThreads)) {
+            glfwTerminate();
+            return -1;
+        }
+        std::cout << "Curl-noise field " << config.curlResolution << "x" << config.curlResolution << ": " << curlNoise.BakedSlices() << " slices baked in "
+            << curlNoise.BakeMilliseconds() << " ms, " << curlNoise.CachedSlices() << " from the cache" << std::endl;
     }
 
-    GLuint fragmentShader = CompileShader(fragmentShaderSource, GL_FRAGMENT_SHADER); // Compile fragment shader
+    // The particles were generated while the context came up, usually they are ready by now
+    {
+        StartupPhase phase(startupTimeline, "wait for particles");
+        bool generated = startupTasks.Wait(generateTask);
+        if (!generated || (packingCheckTask != -1 && !startupTasks.Wait(packingCheckTask))) {
+            glfwTerminate();
+            return -1;
+        }
+        startupPool.reset(); // Its threads are not needed past the startup
+    }
 
-    glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success); // Check for shader compile errors
-    if (!success) {
-        glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
-        std::cerr << "ERROR::FRAGMENTSHADER::COMPILATION_FAILED\n" << infoLog << std::endl;
+    // Create the SSBO(s) for particles in the selected layout
+    {
+        StartupPhase phase(startupTimeline, "upload particles");
+        if (!particleStorage.Init(particles, config.particleLayout, config.pingPong, dynamicVelocity, emitterTable, seed)) {
+            glfwTerminate();
+            return -1;
+        }
     }
 
-    GLuint renderShaderProgram = glCreateProgram(); // Create render shader program
-    glAttachShader(renderShaderProgram, vertexShader); // Attach vertex shader
-    glAttachShader(renderShaderProgram, fragmentShader); // Attach fragment shader
-    glLinkProgram(renderShaderProgram); // Link render shader program
+    // The CPU backend keeps its own copy of the state and uploads it for every draw
+    CpuSimulation cpuSimulation;
+    if (config.backend == SimulationBackend::Cpu) {
+        cpuSimulation.Init(particles, config.cpuThreads, seed);
+        cpuSimulation.SetForces(gravity, config.integrator);
+        cpuSimulation.SetEmitters(emitterTable);
+    }
 
-    glGetProgramiv(renderShaderProgram, GL_LINK_STATUS, &success); // Check for linking errors
-    if (!success) {
-        glGetProgramInfoLog(renderShaderProgram, 512, NULL, infoLog);
-        std::cerr << "ERROR::RENDERPROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+    // Validation steps a CPU reference next to the compute shader
+    SimulationValidator validator;
+    std::vector<Particle> validatedParticles;
+    if (config.validateFrames > 0) {
+        validator.Init(particles, config.particleLayout, gravity, config.integrator, config.maxSubsteps, emitterTable, config.cpuThreads, seed);
+    }
+    std::vector<Particle>().swap(particles); // The GPU (or the CPU backend) owns the particles from here on, release the host copy
+
+    // Resolve everything the loop touches once, the loop itself does no name lookups
+    size_t stillCompiling = shaderVariants.Pending();
+    auto programWaitStart = std::chrono::high_resolution_clock::now();
+    {
+        StartupPhase phase(startupTimeline, "finish programs");
+        if (!shaderVariants.Finish()) {
+            glfwTerminate();
+            return -1;
+        }
+        for (const ProgramSetup& setup : programSetups) {
+            setup.resolve();
+        }
+        if (config.sortParticles) {
+            particleSort.ResolvePrograms();
+        }
+    }
+    auto programsReady = std::chrono::high_resolution_clock::now();
+    std::cout << "Programs ready " << std::chrono::duration<double, std::milli>(programsReady - programBuildStart).count() << " ms after submission, "
+        << std::chrono::duration<double, std::milli>(programsReady - programWaitStart).count() << " ms of it waiting on them (" << shaderVariants.Size() << " variants, "
+        << (GetShaderSourceMode() == ShaderSourceMode::Embedded ? "embedded" : "disk") << " sources, ";
+    if (parallelCompile) {
+        std::cout << "parallel compile, " << stillCompiling << " still compiling after the particle setup";
+    }
+    else {
+        std::cout << "serial compile";
     }
+    if (programCache.Enabled()) {
+        std::cout << ", shader cache: " << programCache.Hits() << " hits, " << programCache.Misses() << " misses, " << programCache.Rejected() << " rejected";
+    }
+    std::cout << ")" << std::endl;
 
-    // Create the SSBO for particles
-    GLuint particleSSBO;  
-    glGenBuffers(1, &particleSSBO); // Create SSBO
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, particleSSBO);  // Bind SSBO
-    glBufferData(GL_SHADER_STORAGE_BUFFER, particles.size() * sizeof(Particle), particles.data(), GL_DYNAMIC_DRAW); // Allocate memory for SSBO
+    // Rebuild programs in the background when their shader files change
+    ShaderReloader shaderReloader;
+    if (config.hotReload) {
+        for (const ProgramSetup& setup : programSetups) {
+            shaderReloader.Watch(**setup.program, setup.name, setup.stages, setup.resolve);
+        }
+        if (!shaderReloader.Start(window)) {
+            std::cerr << "Shader hot reload disabled" << std::endl;
+            shaderReloader.Stop();
+        }
+    }
 
-    // Setup VAO and VBO for rendering particles
-    GLuint particleVAO, particleVBO;
+    // Setup VAO for rendering particles, the vertex data is read straight from the SSBO(s)
+    GLuint particleVAO;
     glGenVertexArrays(1, &particleVAO); // Create VAO
-    glGenBuffers(1, &particleVBO); // Create VBO
-    glBindVertexArray(particleVAO); // Bind VAO
-    glBindBuffer(GL_ARRAY_BUFFER, particleVBO); // Bind VBO
-    glBufferData(GL_ARRAY_BUFFER, particles.size() * sizeof(Particle), nullptr, GL_STREAM_DRAW); // Allocate memory for VBO
-
-    // Vertex attributes
-    glEnableVertexAttribArray(0); // Position
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Particle), (void*)offsetof(Particle, position)); // Position
-    glEnableVertexAttribArray(1); // Color
-    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Particle), (void*)offsetof(Particle, color)); // Color
+    particleStorage.SetupVertexArray(particleVAO); // Position and color attributes for the selected layout
 
-    glBindBuffer(GL_ARRAY_BUFFER, 0); // Unbind VBO
-    glBindVertexArray(0); // Unbind VAO
+    // Optional asynchronous readback of a few particles for debugging
+    ParticleInspector inspector;
+    if (!inspector.Init(particleStorage, config.inspectCount, config.inspectStride, config.inspectInterval, config.inspectLatency)) {
+        std::cerr << "Particle inspector disabled" << std::endl;
+    }
 
 
 
@@ -169,100 +533,428 @@ int main() {
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA); // Set blending function
 
 
+    // Benchmark bookkeeping, only frames after the warmup are measured
+    BenchmarkStats benchmark;
+    benchmark.Reserve(config.benchmarkFrames);
+    int totalFrames = config.benchmarkFrames > 0 ? config.warmupFrames + config.benchmarkFrames : 0;
+    if (config.validateFrames > 0) {
+        totalFrames = config.validateFrames;
+    }
+    int frameIndex = 0;
+    std::chrono::high_resolution_clock::time_point simStartTime, simEndTime;
+
+    // Passes of a frame and the buffers each one touches, the graph inserts the memory barriers between them
+    FrameGraph frameGraph;
+    GpuProfiler gpuProfiler;
+    if (!config.gpuProfilePath.empty()) {
+        const int GPU_PROFILE_LATENCY = 3; // Frames before a frame's timestamps are read back
+        if (gpuProfiler.Init(GPU_PROFILE_LATENCY)) {
+            frameGraph.SetProfiler(&gpuProfiler);
+        }
+        else {
+            std::cerr << "GPU profiling disabled" << std::endl;
+        }
+    }
+    std::vector<FrameGraph::Resource> streamSources, streamTargets; // Per stream: state read by the simulation, state written and drawn
+    std::vector<FrameGraph::Usage> simulateUsages, validateUsages, copyUsages, drawUsages;
+    std::vector<FrameGraph::Usage> prepareUsages, emitUsages, drawArgsUsages, sortKeysUsages, sortUsages, emitterUploadUsages;
+    FrameGraph::Resource listState = -1, aliveCurrent = -1, aliveNext = -1, deadList = -1;
+    if (useLists) {
+        listState = frameGraph.AddBuffer("ListState");
+        aliveCurrent = frameGraph.AddBuffer("AliveCurrent");
+        aliveNext = frameGraph.AddBuffer("AliveNext");
+        deadList = frameGraph.AddBuffer("DeadList");
+        prepareUsages = { { listState, BufferAccess::ShaderStorageRead }, { listState, BufferAccess::ShaderStorageWrite } };
+        emitUsages = { { listState, BufferAccess::IndirectRead }, { listState, BufferAccess::ShaderStorageRead }, { listState, BufferAccess::ShaderStorageWrite },
+            { deadList, BufferAccess::ShaderStorageRead }, { aliveNext, BufferAccess::ShaderStorageWrite } };
+        simulateUsages = { { listState, BufferAccess::IndirectRead }, { listState, BufferAccess::ShaderStorageRead }, { listState, BufferAccess::ShaderStorageWrite },
+            { aliveCurrent, BufferAccess::ShaderStorageRead }, { aliveNext, BufferAccess::ShaderStorageWrite }, { deadList, BufferAccess::ShaderStorageWrite } };
+        drawArgsUsages = { { listState, BufferAccess::CopyRead }, { listState, BufferAccess::CopyWrite } };
+        drawUsages = { { listState, BufferAccess::IndirectRead } };
+        if (!config.sortParticles) {
+            drawUsages.push_back({ aliveNext, BufferAccess::IndexRead });
+        }
+    }
+    FrameGraph::Resource sortKeys = -1, sortValues = -1;
+    if (config.sortParticles) {
+        sortKeys = frameGraph.AddBuffer("SortKeys");
+        sortValues = frameGraph.AddBuffer("SortValues");
+        sortKeysUsages = { { sortKeys, BufferAccess::ShaderStorageWrite }, { sortValues, BufferAccess::ShaderStorageWrite } };
+        if (useLists) {
+            sortKeysUsages.push_back({ listState, BufferAccess::ShaderStorageRead });
+            sortKeysUsages.push_back({ aliveNext, BufferAccess::ShaderStorageRead });
+        }
+        sortUsages = { { sortKeys, BufferAccess::ShaderStorageRead }, { sortKeys, BufferAccess::ShaderStorageWrite },
+            { sortValues, BufferAccess::ShaderStorageRead }, { sortValues, BufferAccess::ShaderStorageWrite } };
+        drawUsages.push_back({ sortValues, BufferAccess::IndexRead });
+    }
+    FrameGraph::Resource emitterTableResource = -1, emitterState = -1;
+    if (useEmitters) {
+        // Uploads are ordered by GL itself, the table never needs a barrier; the GPU-written state does
+        emitterTableResource = frameGraph.AddBuffer("EmitterTable");
+        emitterUploadUsages = { { emitterTableResource, BufferAccess::CopyWrite } };
+        if (config.backend == SimulationBackend::Gpu) {
+            simulateUsages.push_back({ emitterTableResource, BufferAccess::ShaderStorageRead });
+        }
+        if (config.sortParticles) {
+            sortKeysUsages.push_back({ emitterTableResource, BufferAccess::ShaderStorageRead });
+        }
+        if (useLists) {
+            emitterState = frameGraph.AddBuffer("EmitterState");
+            prepareUsages.push_back({ emitterTableResource, BufferAccess::ShaderStorageRead });
+            prepareUsages.push_back({ emitterState, BufferAccess::ShaderStorageRead });
+            prepareUsages.push_back({ emitterState, BufferAccess::ShaderStorageWrite });
+            emitUsages.push_back({ emitterTableResource, BufferAccess::ShaderStorageRead });
+            emitUsages.push_back({ emitterState, BufferAccess::ShaderStorageRead });
+        }
+    }
+    for (size_t i = 0; i < particleStorage.Streams().size(); ++i) {
+        const ParticleStream& stream = particleStorage.Streams()[i];
+        streamSources.push_back(frameGraph.AddBuffer(stream.name + "Source"));
+        streamTargets.push_back(frameGraph.AddBuffer(stream.name + "Target"));
+        if (config.backend == SimulationBackend::Cpu) {
+            if (stream.simulated) {
+                simulateUsages.push_back({ streamTargets.back(), BufferAccess::CopyWrite }); // Mapped upload
+            }
+        }
+        else {
+            simulateUsages.push_back({ streamSources.back(), BufferAccess::ShaderStorageRead });
+            if (stream.simulated) {
+                simulateUsages.push_back({ streamTargets.back(), BufferAccess::ShaderStorageWrite });
+            }
+            if (useLists) {
+                emitUsages.push_back({ streamSources.back(), BufferAccess::ShaderStorageRead });
+                if (stream.simulated || stream.emitted) {
+                    emitUsages.push_back({ streamTargets.back(), BufferAccess::ShaderStorageWrite });
+                }
+            }
+        }
+        validateUsages.push_back({ streamTargets.back(), BufferAccess::CopyRead });
+        if (config.sortParticles) {
+            sortKeysUsages.push_back({ streamTargets.back(), BufferAccess::ShaderStorageRead });
+        }
+        copyUsages.push_back({ streamTargets.back(), BufferAccess::CopyRead });
+        if (particleStorage.IsVertexSource(i)) {
+            drawUsages.push_back({ streamTargets.back(), BufferAccess::VertexAttribRead });
+        }
+    }
+
+    // Send the emitters changed since last frame, only their entries
+    frameGraph.AddPass("emitters", emitterUploadUsages,
+        [&]() { emitters.Upload(); },
+        [&]() { return useEmitters; });
+
+    // Keep the two field slices around the frame's time in the texture, the one scrolling in was made ahead by
+    // the field's baker thread and is only uploaded. Texture uploads are ordered by GL itself, the field needs no barrier.
+    frameGraph.AddPass("field", {},
+        [&]() { fieldSlice = curlNoise.Update(simulatedTime); },
+        [&]() { return useCurlNoise; });
+
+    // Pooled mode: pop this frame's emission off the dead list and size the emit and simulate dispatches
+    float emitAccumulator = 0.0f; // Fractional particles carried over to the next frame
+    frameGraph.AddPass("prepare", prepareUsages,
+        [&]() {
+            prepareProgram->Use();
+            particleLists.Bind();
+            if (useEmitters) {
+                simulatedTimeUniform.Set(substeps * timestep.StepTime()); // Every emitter accumulates its own rate on the GPU
+                emitters.Bind();
+            }
+            else {
+                emitAccumulator += config.emitRate * (substeps * timestep.StepTime()); // Emission follows simulated time
+                GLuint emitRequest = static_cast<GLuint>(std::min<float>(emitAccumulator, float(particleCount)));
+                emitAccumulator -= float(emitRequest);
+                emitRequestUniform.Set(emitRequest);
+            }
+            glDispatchCompute(1, 1, 1);
+        },
+        [&]() { return useLists; });
+
+    // Revive the popped slots at the emitter, they join the next alive list
+    frameGraph.AddPass("emit", emitUsages,
+        [&]() {
+            emitProgram->Use();
+            mousePosUniform.Set(mousePos);
+            if (useEmitters) {
+                emitters.Bind();
+            }
+            particleStorage.BindForSimulation();
+            particleStorage.AcquireTarget();
+            particleLists.DispatchEmit();
+        },
+        [&]() { return useLists; });
+
+    // Update particles using compute shader, or on the CPU followed by an upload
+    frameGraph.AddPass("simulate", simulateUsages,
+        [&]() {
+            if (config.backend == SimulationBackend::Cpu) {
+                cpuSimulation.Update(timestep.StepTime(), substeps, mousePos);
+                simEndTime = std::chrono::high_resolution_clock::now(); // The upload counts as render time
+                cpuSimulation.Upload(particleStorage);
+                return;
+            }
+            computeProgram->Use();
+            mousePosUniform.Set(mousePos); // Already set by the emit pass in pooled mode, a no-op then
+            deltaTimeUniform.Set(timestep.StepTime());
+            substepsUniform.Set(GLuint(substeps)); // All of the frame's steps in one dispatch
+            if (useEmitters) {
+                emitters.Bind(); // Every emitter's particles are in this one dispatch
+            }
+            if (useCurlNoise) {
+                fieldSliceUniform.Set(fieldSlice);
+                curlNoise.Bind();
+            }
+            particleStorage.BindForSimulation(); // Bind the SSBO(s) to the compute shader
+            particleStorage.AcquireTarget(); // The target may still be read by last frame's work
+            if (useLists) {
+                particleLists.DispatchSimulate(); // Only the alive slots, sized on the GPU
+            }
+            else {
+                glDispatchCompute(dispatchSize.x, dispatchSize.y, dispatchSize.z); // Dispatch compute shader
+            }
+            particleStorage.ReleaseSource();
+            if (config.headless) {
+                glFinish(); // Wait for the GPU so the CPU clock brackets the simulation
+            }
+            simEndTime = std::chrono::high_resolution_clock::now();
+        });
+
+    // Compare the frame's result with the CPU reference, a synchronous readback
+    frameGraph.AddPass("validate", validateUsages,
+        [&]() {
+            particleStorage.ReadParticles(validatedParticles);
+            validator.Check(frameIndex, timestep.StepTime(), substeps, validatedParticles);
+        },
+        [&]() { return config.validateFrames > 0; });
+
+    // Queue a readback of this frame's state for the inspector
+    frameGraph.AddPass("copy", copyUsages,
+        [&]() { inspector.Capture(particleStorage, frameIndex); },
+        [&]() { return inspector.IsCaptureFrame(frameIndex); });
+
+    // Pooled mode: the draw count is the length of the alive list the frame produced
+    frameGraph.AddPass("drawArgs", drawArgsUsages,
+        [&]() { particleLists.UpdateDrawCommand(); },
+        [&]() { return useLists; });
+
+    // Back-to-front order: key every drawn particle, then sort the indices by key
+    frameGraph.AddPass("sortKeys", sortKeysUsages,
+        [&]() {
+            sortKeysProgram->Use();
+            particleStorage.BindForReading();
+            if (useLists) {
+                particleLists.Bind();
+            }
+            if (useEmitters) {
+                emitters.Bind();
+            }
+            sortKeysBlock.Bind(particleSort.KeysBuffer());
+            sortValuesBlock.Bind(particleSort.ValuesBuffer());
+            glDispatchCompute(dispatchSize.x, dispatchSize.y, dispatchSize.z);
+        },
+        [&]() { return config.sortParticles; });
+
+    frameGraph.AddPass("sort", sortUsages,
+        [&]() { particleSort.Sort(particleCount, SORT_KEY_BITS); },
+        [&]() { return config.sortParticles; });
+
+    // Render particles
+    frameGraph.AddPass("draw", drawUsages,
+        [&]() {
+            renderProgram->Use();
+            particleStorage.BindVertexBuffers(particleVAO); // Draw the freshly written buffer(s)
+            if (useLists) {
+                // The alive list is the index buffer, dead slots are never fetched
+                particleLists.Draw(config.sortParticles ? particleSort.ValuesBuffer() : particleLists.NextAliveBuffer());
+            }
+            else if (config.sortParticles) {
+                glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, particleSort.ValuesBuffer()); // Recorded in the bound VAO
+                glDrawElements(GL_POINTS, particleCount, GL_UNSIGNED_INT, nullptr);
+            }
+            else {
+                glDrawArrays(GL_POINTS, 0, particleCount);
+            }
+        });
+
+    // CPU captures cover cpuProfileFrames frames: from --cpu-start, or from the frame after F9 was pressed
+    if (CpuProfiler::Capturing()) {
+        CpuProfiler::Record("startup", startupBegin, CpuProfiler::Now());
+    }
+    int cpuCaptureStart = 0;
+    auto writeCpuProfile = [&]() {
+        CpuProfiler::EndCapture();
+        std::string path = (config.cpuProfilePath.empty() ? std::string("cpu_profile") : config.cpuProfilePath) + ".json";
+        std::ofstream trace(path);
+        CpuProfiler::WriteChromeTrace(trace);
+        if (!trace) {
+            std::cerr << "ERROR::CPU_PROFILER::WRITE_FAILED " << path << std::endl;
+            return;
+        }
+        std::cout << "CPU profile of frames " << cpuCaptureStart << " to " << frameIndex - 1 << " written to " << path;
+        if (CpuProfiler::DroppedEvents() > 0) {
+            std::cout << " (" << CpuProfiler::DroppedEvents() << " events dropped)";
+        }
+        std::cout << std::endl;
+    };
+
     // Main loop
-    while (!glfwWindowShouldClose(window)) {
+    while (!glfwWindowShouldClose(window) && (totalFrames == 0 || frameIndex < totalFrames) && validator.Passed()) {
+        if (CpuProfiler::Capturing() && frameIndex >= cpuCaptureStart + config.cpuProfileFrames) {
+            writeCpuProfile();
+        }
+        if (!CpuProfiler::Capturing() && (cpuCaptureRequested || (!config.cpuProfilePath.empty() && config.cpuProfileStart > 0 && frameIndex == config.cpuProfileStart))) {
+            cpuCaptureRequested = false;
+            cpuCaptureStart = frameIndex;
+            CpuProfiler::BeginCapture();
+        }
+        CpuZone frameZone("frame");
 
+        auto frameStartTime = std::chrono::high_resolution_clock::now(); // Start of frame for benchmark timing
+        {
+            CpuZone zone("shader reload poll");
+            shaderReloader.Poll(); // Swap in programs the reload worker has finished
+        }
 
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); // Clear the screen
-        glPointSize(10.0f); // Set point size if using GL_POINTS
+        {
+            CpuZone zone("clear");
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); // Clear the screen
+            glPointSize(10.0f); // Set point size if using GL_POINTS
+        }
 
         // Calculate delta time 
         auto currentFrameTime = std::chrono::high_resolution_clock::now(); // Get current time
         deltaTime = std::chrono::duration<float, std::chrono::seconds::period>(currentFrameTime - lastFrameTime).count(); // Calculate delta time
         lastFrameTime = currentFrameTime; // Update last frame time
+        if (config.fixedDeltaTime > 0.0f) {
+            deltaTime = config.fixedDeltaTime; // Fixed step keeps benchmark runs repeatable
+        }
+        if (config.validateFrames > 0) {
+            deltaTime = SimulationValidator::DeltaTime(frameIndex); // The reference replays the same inputs
+            mousePos = SimulationValidator::MousePosition(frameIndex);
+        }
+        substeps = timestep.Advance(deltaTime);
+        if (useEmitters) {
+            emitters.SetPosition(0, mousePos); // The first emitter follows the mouse, uploaded only when it moved
+        }
 
-        // Update particles using compute shader
-        glUseProgram(computeShaderProgram); 
-
-        // Bind the SSBO
-        glBindBuffer(GL_SHADER_STORAGE_BUFFER, particleSSBO);
-
-        // Map the SSBO to a pointer
-        Particle* particleData = (Particle*)glMapBuffer(GL_SHADER_STORAGE_BUFFER, GL_READ_ONLY);
-
-        if (particleData) {
-            // Read particle data for debugging
-            for (int i = 0; i < 10; ++i) {
-                std::cout << "Particle " << i << ": Pos(" << particleData[i].position.x << ", "
-                    << particleData[i].position.y << "), Vel(" << particleData[i].velocity.x << ", "
-                    << particleData[i].velocity.y << "), Age: " << particleData[i].age
-                    << ", Lifetime: " << particleData[i].lifeTime << std::endl;
+        // Simulate, read back and draw
+        for (size_t i = 0; i < streamSources.size(); ++i) {
+            frameGraph.SetBuffer(streamSources[i], particleStorage.SourceBuffer(i));
+            frameGraph.SetBuffer(streamTargets[i], particleStorage.TargetBuffer(i));
+        }
+        if (useLists) {
+            frameGraph.SetBuffer(listState, particleLists.StateBuffer());
+            frameGraph.SetBuffer(aliveCurrent, particleLists.CurrentAliveBuffer());
+            frameGraph.SetBuffer(aliveNext, particleLists.NextAliveBuffer());
+            frameGraph.SetBuffer(deadList, particleLists.DeadBuffer());
+        }
+        if (useEmitters) {
+            frameGraph.SetBuffer(emitterTableResource, emitters.TableBuffer());
+            if (useLists) {
+                frameGraph.SetBuffer(emitterState, emitters.StateBuffer());
             }
-
-            // Unmap the buffer after reading
-            glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
         }
-
-        // Unbind the SSBO
-        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
-
-        glBindBuffer(GL_COPY_READ_BUFFER, particleSSBO); // Bind the SSBO as the copy read buffer
-        glBindBuffer(GL_COPY_WRITE_BUFFER, particleVBO); // Bind the VBO as the copy write buffer
-        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, particles.size() * sizeof(Particle)); // Copy the SSBO to the VBO
-
-        // Uniform update checks
-        GLint mousePosLoc = glGetUniformLocation(computeShaderProgram, "mousePos");
-        GLint deltaTimeLoc = glGetUniformLocation(computeShaderProgram, "deltaTime");
-
-        if (mousePosLoc != -1) {
-            glUniform2f(mousePosLoc, mousePos.x, mousePos.y);
+        if (config.sortParticles) {
+            frameGraph.SetBuffer(sortKeys, particleSort.KeysBuffer());
+            frameGraph.SetBuffer(sortValues, particleSort.ValuesBuffer());
         }
-        else {
-            std::cerr << "mousePos uniform location not found." << std::endl;
+        simStartTime = std::chrono::high_resolution_clock::now();
+        if (frameIndex >= config.warmupFrames) {
+            gpuProfiler.BeginFrame(frameIndex);
         }
-
-        if (deltaTimeLoc != -1) {
-            glUniform1f(deltaTimeLoc, deltaTime);
+        {
+            CpuZone zone("frame graph"); // Every pass is a zone of its own inside
+            frameGraph.Execute();
         }
-        else {
-            std::cerr << "deltaTime uniform location not found." << std::endl;
+        gpuProfiler.EndFrame();
+        simulatedTime += substeps * timestep.StepTime();
+        particleStorage.Swap();
+        particleLists.Swap();
+        if (config.printFrameGraph && frameIndex < 2) {
+            std::cout << "Frame graph barriers, frame " << frameIndex << ":\n";
+            frameGraph.PrintLastFrame(std::cout); // The first frame has no earlier writes, the second shows the steady state
         }
-        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, particleSSBO); // Bind the SSBO to the compute shader
-        glDispatchCompute(NUM_PARTICLES / WORK_GROUP_SIZE, 1, 1); // Dispatch compute shader
-
-    
-
-        // Render particles
-
-        glUseProgram(renderShaderProgram);
-        glBindVertexArray(particleVAO);
-        glDrawArrays(GL_POINTS, 0, NUM_PARTICLES);
 
         // Swap buffers and poll IO events
-        glfwSwapBuffers(window);
-        glfwPollEvents();
-    }
-
-        glGetError(); // Clear error flag
+        {
+            CpuZone zone("present");
+            if (config.headless) {
+                glFinish(); // Nothing to present, wait for the draw instead
+            }
+            else {
+                glfwSwapBuffers(window);
+            }
+        }
+        if (frameIndex == 0) {
+            startupTimeline.Print(std::cout, CpuProfiler::Now()); // Time to first frame and what overlapped on the way
+        }
+        auto renderEndTime = std::chrono::high_resolution_clock::now();
+        {
+            CpuZone zone("poll events");
+            glfwPollEvents();
+        }
+        {
+            CpuZone zone("readbacks");
+            inspector.Poll(frameIndex, std::cout); // Print captures that finished a few frames ago
+            gpuProfiler.Poll(frameIndex);
+        }
 
-        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT); // Ensure that the compute shader has finished writing to the buffer
+        if (config.benchmarkFrames > 0 && frameIndex >= config.warmupFrames) {
+            benchmark.AddFrame(
+                std::chrono::duration<double>(renderEndTime - frameStartTime).count(),
+                std::chrono::duration<double>(simEndTime - simStartTime).count(),
+                std::chrono::duration<double>(renderEndTime - simEndTime).count());
+        }
+        ++frameIndex;
+    }
 
-        
+    if (CpuProfiler::Capturing()) {
+        writeCpuProfile(); // The run ended inside the capture window
+    }
+    if (benchmark.FrameCount() > 0) {
+        std::string backend = "gpu";
+        if (config.backend == SimulationBackend::Cpu) {
+            backend = std::string("cpu (") + cpuSimulation.KernelName() + ", " + std::to_string(cpuSimulation.ThreadCount()) + " threads)";
+        }
+        benchmark.Report(std::cout, particleCount, reinterpret_cast<const char*>(glGetString(GL_RENDERER)), backend);
+        std::cout << "sim_time_dropped_s: " << timestep.DroppedTime() << std::endl; // Frames longer than the substep cap covers
+    }
+    if (gpuProfiler.Enabled()) {
+        gpuProfiler.Finish();
+        gpuProfiler.Report(std::cout);
+        std::ofstream csv(config.gpuProfilePath + ".csv");
+        gpuProfiler.WriteCsv(csv);
+        std::ofstream trace(config.gpuProfilePath + ".json");
+        gpuProfiler.WriteChromeTrace(trace);
+        if (!csv || !trace) {
+            std::cerr << "ERROR::GPU_PROFILER::WRITE_FAILED " << config.gpuProfilePath << std::endl;
+        }
+    }
+    if (config.validateFrames > 0) {
+        validator.Report(std::cout);
+    }
+    const int exitCode = validator.Passed() ? 0 : 1; // Lets scripts gate on the validation
 
     // Cleanup
-    glDeleteBuffers(1, &particleSSBO);
+    shaderReloader.Stop();
+    inspector.Destroy();
+    gpuProfiler.Destroy();
+    particleStorage.Destroy();
+    particleLists.Destroy();
+    emitters.Destroy();
+    curlNoise.Destroy();
+    particleSort.Destroy();
     glDeleteVertexArrays(1, &particleVAO);
-    glDeleteBuffers(1, &particleVBO);
-    glDeleteShader(computeShader);
-    glDeleteProgram(computeShaderProgram);
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
-    glDeleteProgram(renderShaderProgram);
+    shaderVariants.Clear();
+    glDeleteFramebuffers(1, &offscreenFBO);
+    glDeleteRenderbuffers(1, &offscreenColor);
+    ShaderProgram::SetBinaryCache(nullptr);
     glfwTerminate();
-    return 0;
+    return exitCode;
 }
 
 void mouse_callback(GLFWwindow* window, double xpos, double ypos) {
+    CpuZone zone("mouse callback");
     int width, height;
     glfwGetFramebufferSize(window, &width, &height);
     mousePos.x = (xpos / width) * 2.0f - 1.0f; // Convert to normalized device coordinates
@@ -270,29 +962,8 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos) {
     std::cout << "Mouse position: " << mousePos.x << ", " << mousePos.y << std::endl;
 }
 
-std::string ReadShaderFile(const std::string& shaderPath) {
-    std::ifstream shaderFile(shaderPath);
-    std::stringstream shaderStream;
-    shaderStream << shaderFile.rdbuf();
-    shaderFile.close();
-    return shaderStream.str();
-}
-
-GLuint CompileShader(const std::string& source, GLenum shaderType) {
-    GLuint shader = glCreateShader(shaderType);
-    const char* src = source.c_str();
-    glShaderSource(shader, 1, &src, nullptr);
-    glCompileShader(shader);
-
-    // Check for shader compile errors
-    GLint success;
-    char infoLog[512];
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(shader, 512, nullptr, infoLog);
-        std::cerr << "ERROR::SHADER::COMPILATION_FAILED\n" << infoLog << std::endl;
-        return 0;
+void key_callback(GLFWwindow* /*window*/, int key, int /*scancode*/, int action, int /*mods*/) {
+    if (key == GLFW_KEY_F9 && action == GLFW_PRESS) {
+        cpuCaptureRequested = true;
     }
-
-    return shader;
-}
\ No newline at end of file
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <glm.hpp>
+
+// Particle structure, laid out to match the std430 ParticleBuffer in compute_shader.glsl
+struct Particle {
+    glm::vec2 position; // Add position attribute
+    glm::vec2 velocity; // Add velocity attribute
+    glm::vec4 color;    // Add color attribute
+    float age;          // Add age attribute
+    float lifeTime;     // Add lifetime attribute, always ParticleLifetime(seed, id, respawnCount) or EmitterLifetime() of its emitter
+    glm::uint respawnCount; // Respawns so far, the RNG counter of the current lifetime
+    glm::uint emitter;  // Index into the emitter table, 0 without emitters
+};
+
+static_assert(sizeof(Particle) == 48, "Particle must match the std430 array stride");
+
+// Compact particle record matching PackedParticle in compute_shader.glsl. The lifetime is not stored,
+// it is derived from the respawn count and the particle id by the shared RNG.
+// All members are 4-byte scalars on the GLSL side, so the std430 array stride is the 20-byte size
+struct PackedParticle {
+    glm::vec2 position;    // Full precision, it accumulates every frame
+    glm::uint velocity;    // packHalf2x16
+    glm::uint color;       // packUnorm4x8
+    glm::uint ageRespawn;  // Age as a unorm16 fraction of the lifetime in the low half, respawn count in the high half
+};
+
+static_assert(sizeof(PackedParticle) == 20, "PackedParticle must match the std430 array stride");
+
+// How particle state is laid out in GPU memory
+enum class ParticleLayout {
+    AoS, // One buffer of std430 Particle records
+    SoA,    // One buffer per field: position, velocity, color, age, respawn count (lifetime is derived), emitter with emitters
+    Packed, // One 20-byte PackedParticle record per particle
+};
+
+inline const char* ParticleLayoutName(ParticleLayout layout) {
+    switch (layout) {
+    case ParticleLayout::AoS: return "aos";
+    case ParticleLayout::SoA: return "soa";
+    case ParticleLayout::Packed: return "packed";
+    }
+    return "unknown";
+}
+
+// How the update advances position and velocity by one fixed step. They only differ once a force acts,
+// without one every integrator moves the particle by velocity * step.
+enum class ParticleIntegrator {
+    ExplicitEuler,     // Position from the old velocity, then the velocity
+    SemiImplicitEuler, // Velocity first, the position moves with the new one
+    VelocityVerlet,    // Position from velocity and acceleration, velocity from the average of the old and new accelerations
+};
+
+inline const char* ParticleIntegratorName(ParticleIntegrator integrator) {
+    switch (integrator) {
+    case ParticleIntegrator::ExplicitEuler: return "euler";
+    case ParticleIntegrator::SemiImplicitEuler: return "semi-implicit";
+    case ParticleIntegrator::VelocityVerlet: return "verlet";
+    }
+    return "unknown";
+}
+
+// Define compute_shader.glsl selects the integrator variant by
+inline const char* ParticleIntegratorDefine(ParticleIntegrator integrator) {
+    switch (integrator) {
+    case ParticleIntegrator::ExplicitEuler: return "INTEGRATOR_EXPLICIT_EULER";
+    case ParticleIntegrator::SemiImplicitEuler: return "INTEGRATOR_SEMI_IMPLICIT_EULER";
+    case ParticleIntegrator::VelocityVerlet: return "INTEGRATOR_VELOCITY_VERLET";
+    }
+    return "INTEGRATOR_EXPLICIT_EULER";
+}
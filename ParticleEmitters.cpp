@@ -0,0 +1,144 @@
+#include "ParticleEmitters.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+// Mirrors EmitterState in particle_emitters.glsl
+struct EmitterState {
+    GLfloat accumulator; // Fractional particles carried over to the next frame
+    GLuint firstSlot;    // First of this frame's popped slots the emitter revives
+};
+
+std::vector<EmitterParams> DefaultEmitters(size_t count, float totalRate, uint32_t seed) {
+    std::vector<EmitterParams> emitters(count);
+    const float rate = count > 0 ? totalRate / float(count) : 0.0f;
+    for (size_t i = 0; i < count; ++i) {
+        EmitterParams& emitter = emitters[i];
+        emitter.rate = rate;
+        if (i == 0) {
+            emitter.position = glm::vec2(0.0f);
+            emitter.direction = glm::vec2(0.0f, 1.0f);
+            emitter.spread = 1.0f;
+            emitter.speed = glm::vec2(PARTICLE_LAUNCH_SPEED);
+            emitter.lifetime = glm::vec2(1.0f, PARTICLE_MAX_LIFETIME);
+            emitter.colorMin = glm::vec3(0.0f);
+            emitter.colorMax = glm::vec3(1.0f);
+            continue;
+        }
+
+        // Keyed apart from the particles' draws, which use the seed as it is
+        glm::uvec3 bits = ParticleRandom(seed ^ 0x9E3779B9u, static_cast<uint32_t>(i), 0);
+        float angle = 6.28318531f * float(i - 1) / float(count - 1);
+        glm::vec2 outward(std::cos(angle), std::sin(angle));
+        glm::vec3 hue = glm::abs(glm::fract(glm::vec3(RandomUnit(bits.x)) + glm::vec3(0.0f, 2.0f / 3.0f, 1.0f / 3.0f)) * 2.0f - 1.0f);
+        emitter.position = outward * 0.6f;
+        emitter.direction = outward;
+        emitter.spread = 0.1f + 0.5f * RandomUnit(bits.y);
+        emitter.speed = glm::vec2(0.1f, 0.1f + 0.3f * RandomUnit(bits.z));
+        emitter.lifetime = glm::vec2(0.5f, 0.5f + 2.0f * RandomUnit(bits.x ^ bits.y));
+        emitter.colorMin = hue * 0.5f;
+        emitter.colorMax = glm::min(hue + 0.25f, glm::vec3(1.0f));
+    }
+    return emitters;
+}
+
+bool ParticleEmitters::Init(const std::vector<EmitterParams>& emitters) {
+    params = emitters;
+    dirty.clear();
+    dirtyFlags.assign(params.size(), false);
+
+    glGenBuffers(1, &tableBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, tableBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, GLsizeiptr(params.size() * sizeof(EmitterParams)), params.data(), GL_DYNAMIC_DRAW);
+
+    std::vector<EmitterState> states(params.size(), EmitterState{ 0.0f, 0u });
+    glGenBuffers(1, &stateBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, stateBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, GLsizeiptr(states.size() * sizeof(EmitterState)), states.data(), GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    if (glGetError() == GL_OUT_OF_MEMORY) {
+        std::cerr << "ERROR::EMITTERS::OUT_OF_MEMORY" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void ParticleEmitters::Destroy() {
+    glDeleteBuffers(1, &tableBuffer);
+    glDeleteBuffers(1, &stateBuffer);
+    tableBuffer = stateBuffer = 0;
+    params.clear();
+    dirty.clear();
+    dirtyFlags.clear();
+}
+
+void ParticleEmitters::MarkDirty(size_t index) {
+    if (!dirtyFlags[index]) {
+        dirtyFlags[index] = true;
+        dirty.push_back(static_cast<uint32_t>(index));
+    }
+}
+
+void ParticleEmitters::Set(size_t index, const EmitterParams& emitter) {
+    params[index] = emitter;
+    MarkDirty(index);
+}
+
+void ParticleEmitters::SetPosition(size_t index, glm::vec2 position) {
+    if (params[index].position != position) {
+        params[index].position = position;
+        MarkDirty(index);
+    }
+}
+
+void ParticleEmitters::Upload() {
+    if (dirty.empty()) {
+        return;
+    }
+    std::sort(dirty.begin(), dirty.end());
+
+    // Past a few runs one update spanning them all is cheaper than many small ones
+    const size_t MAX_RUNS = 8;
+    size_t runs = 1;
+    for (size_t i = 1; i < dirty.size(); ++i) {
+        runs += dirty[i] != dirty[i - 1] + 1 ? 1 : 0;
+    }
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, tableBuffer);
+    auto uploadRange = [&](uint32_t first, uint32_t last) {
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, GLintptr(first * sizeof(EmitterParams)), GLsizeiptr((last - first + 1) * sizeof(EmitterParams)), &params[first]);
+    };
+    if (runs > MAX_RUNS) {
+        uploadRange(dirty.front(), dirty.back());
+    }
+    else {
+        size_t runStart = 0;
+        for (size_t i = 1; i <= dirty.size(); ++i) {
+            if (i == dirty.size() || dirty[i] != dirty[i - 1] + 1) {
+                uploadRange(dirty[runStart], dirty[i - 1]);
+                runStart = i;
+            }
+        }
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    for (uint32_t index : dirty) {
+        dirtyFlags[index] = false;
+    }
+    dirty.clear();
+}
+
+void ParticleEmitters::ResolveBlocks(const ShaderProgram& program) {
+    if (program.HasStorageBlock("EmitterBuffer")) {
+        tableBlock = program.GetStorageBlock("EmitterBuffer");
+    }
+    if (program.HasStorageBlock("EmitterStateBuffer")) {
+        stateBlock = program.GetStorageBlock("EmitterStateBuffer");
+    }
+}
+
+void ParticleEmitters::Bind() const {
+    tableBlock.Bind(tableBuffer);
+    stateBlock.Bind(stateBuffer);
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include <glew.h>
+#include <glm.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "ParticleRandom.h"
+#include "ShaderProgram.h"
+
+// One emitter, laid out to match the std430 Emitter in particle_emitters.glsl. Every range is drawn by
+// EmitterRange(), its ends must be non-negative and in order.
+struct EmitterParams {
+    glm::vec3 colorMin;  // Each rgb channel of a new life is drawn between the two, alpha starts at 1
+    float spread;        // Tangent of the launch cone's half angle
+    glm::vec3 colorMax;
+    float rate;          // Particles per second, only pooled emission uses it
+    glm::vec2 position;  // Where its particles respawn, NDC
+    glm::vec2 lifetime;  // Range of a life's length in seconds, [x, y), y at most PARTICLE_MAX_LIFETIME
+    glm::vec2 speed;     // Range of the launch speed, NDC units per second
+    glm::vec2 direction; // Unit axis of the launch cone
+};
+
+static_assert(sizeof(EmitterParams) == 64, "EmitterParams must match the std430 array stride");
+
+// OR'd into the respawn count for the color draws of a life, respawn counts never get this far
+const uint32_t EMITTER_COLOR_COUNTER = 0x80000000u;
+
+// a + (b - a) * t for the 12-bit draw t in the top bits of bits, in 16.16 fixed point. Integer operations
+// only, so every backend gets the same value whether or not it fuses multiply-adds, the same as
+// emitterRange() in particle_emitters.glsl. Needs 0 <= a <= b and b - a below 16.
+inline float EmitterRange(float a, float b, uint32_t bits) {
+    uint32_t low = static_cast<uint32_t>(a * 65536.0f);
+    uint32_t span = static_cast<uint32_t>(b * 65536.0f) - low;
+    return float(low + ((span * (bits >> 20)) >> 12)) * (1.0f / 65536.0f);
+}
+
+// What a particle of emitter draws for its life number respawnCount, the same as particle_emitters.glsl
+inline float EmitterLifetime(const EmitterParams& emitter, uint32_t seed, uint32_t id, uint32_t respawnCount) {
+    return EmitterRange(emitter.lifetime.x, emitter.lifetime.y, ParticleRandom(seed, id, respawnCount).x);
+}
+
+// The cone's direction goes through a normalize, which is not exact on the GPU anyway
+inline glm::vec2 EmitterLaunchVelocity(const EmitterParams& emitter, uint32_t seed, uint32_t id, uint32_t respawnCount) {
+    glm::uvec3 bits = ParticleRandom(seed, id, respawnCount); // x is the lifetime
+    float offset = emitter.spread * (RandomUnit(bits.y) * 2.0f - 1.0f);
+    glm::vec2 direction = emitter.direction + glm::vec2(-emitter.direction.y, emitter.direction.x) * offset;
+    return glm::normalize(direction) * EmitterRange(emitter.speed.x, emitter.speed.y, bits.z);
+}
+
+inline glm::vec4 EmitterColor(const EmitterParams& emitter, uint32_t seed, uint32_t id, uint32_t respawnCount) {
+    glm::uvec3 bits = ParticleRandom(seed, id, respawnCount | EMITTER_COLOR_COUNTER);
+    return glm::vec4(EmitterRange(emitter.colorMin.r, emitter.colorMax.r, bits.x), EmitterRange(emitter.colorMin.g, emitter.colorMax.g, bits.y),
+        EmitterRange(emitter.colorMin.b, emitter.colorMax.b, bits.z), 1.0f);
+}
+
+// Emitter 0 at the origin with the look of the single emitter, the rest spread on a ring around it, each
+// with its own cone, colors and lifetimes. totalRate is shared out between them for pooled emission.
+std::vector<EmitterParams> DefaultEmitters(size_t count, float totalRate, uint32_t seed);
+
+// Table of every emitter in one SSBO, read by the compute shader: each particle carries the index of its
+// emitter and respawns from that entry, so all emitters are updated by the one dispatch of the frame.
+// The host keeps the authoritative copy; Set() marks entries dirty and Upload() sends only those, merged
+// into runs of adjacent entries. In pooled mode a second buffer holds what the GPU tracks per emitter.
+class ParticleEmitters {
+public:
+    bool Init(const std::vector<EmitterParams>& emitters);
+    void Destroy();
+
+    size_t Count() const { return params.size(); }
+    const std::vector<EmitterParams>& Params() const { return params; }
+    const EmitterParams& Get(size_t index) const { return params[index]; }
+
+    // Changes take effect at the next Upload()
+    void Set(size_t index, const EmitterParams& emitter);
+    void SetPosition(size_t index, glm::vec2 position);
+
+    // Sends the entries changed since the last call, call before the frame's passes
+    void Upload();
+
+    // Turns on the emitter paths of compute_shader.glsl and list_prepare_shader.glsl
+    static ShaderDefines Defines(size_t count) { return ShaderDefines().Set("EMITTERS").Set("EMITTER_COUNT", std::to_string(count) + "u"); }
+    // Storage bindings of the table and the per-frame emitter state, see particle_emitters.glsl
+    static std::vector<GLuint> StorageBindings() { return { 16, 17 }; }
+
+    // The blocks have fixed bindings; only the ones the program uses are resolved
+    void ResolveBlocks(const ShaderProgram& program);
+    void Bind() const;
+
+    GLuint TableBuffer() const { return tableBuffer; }
+    GLuint StateBuffer() const { return stateBuffer; }
+
+private:
+    void MarkDirty(size_t index);
+
+    std::vector<EmitterParams> params;
+    std::vector<uint32_t> dirty;     // Indices changed since the last upload, each once
+    std::vector<bool> dirtyFlags;
+    GLuint tableBuffer = 0;
+    GLuint stateBuffer = 0;
+    BufferBlock tableBlock, stateBlock;
+};
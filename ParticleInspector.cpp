@@ -0,0 +1,162 @@
+#include "ParticleInspector.h"
+#include "Particle.h"
+#include <iostream>
+#include <algorithm>
+
+bool ParticleInspector::Init(const ParticleStorage& storage, int count, int stride, int interval, int latency) {
+    size_t particleCount = storage.Count();
+    if (count <= 0 || particleCount == 0) {
+        return true; // Inspector disabled
+    }
+
+    sampleStride = std::max(stride, 1);
+    sampleCount = static_cast<int>(std::min<size_t>(count, (particleCount + sampleStride - 1) / sampleStride));
+    captureInterval = std::max(interval, 1);
+    readLatency = std::max(latency, 1);
+    persistent = GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage;
+    particleStorage = &storage;
+
+    // Enough slots to cover the read latency plus the slot being captured
+    slots.resize(readLatency / captureInterval + 2);
+
+    streamCopies.clear();
+    slotSize = 0;
+    for (const ParticleStream& stream : storage.Streams()) {
+        streamCopies.push_back({ stream.elementSize, slotSize });
+        slotSize += sampleCount * stream.elementSize;
+    }
+
+    for (Slot& slot : slots) {
+        glGenBuffers(1, &slot.buffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, slot.buffer);
+        if (persistent) {
+            const GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(GL_COPY_WRITE_BUFFER, slotSize, nullptr, flags);
+            slot.mapped = glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, slotSize, flags);
+            if (!slot.mapped) {
+                std::cerr << "ERROR::INSPECTOR::MAP_FAILED" << std::endl;
+                glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+                Destroy();
+                return false;
+            }
+        }
+        else {
+            glBufferData(GL_COPY_WRITE_BUFFER, slotSize, nullptr, GL_STREAM_READ);
+        }
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    return true;
+}
+
+void ParticleInspector::Destroy() {
+    for (Slot& slot : slots) {
+        if (slot.fence) {
+            glDeleteSync(slot.fence);
+        }
+        if (slot.mapped) {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, slot.buffer);
+            glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        }
+        glDeleteBuffers(1, &slot.buffer);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    slots.clear();
+    sampleCount = 0;
+    pendingSlots = 0;
+}
+
+void ParticleInspector::Capture(const ParticleStorage& storage, int frame) {
+    if (!IsCaptureFrame(frame)) {
+        return;
+    }
+    if (pendingSlots == slots.size()) {
+        ++droppedSamples; // GPU is behind, skip this sample rather than wait
+        return;
+    }
+
+    Slot& slot = slots[nextSlot];
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, slot.buffer);
+    for (size_t s = 0; s < streamCopies.size(); ++s) {
+        const StreamCopy& copy = streamCopies[s];
+        glBindBuffer(GL_COPY_READ_BUFFER, storage.TargetBuffer(s));
+        if (sampleStride == 1) {
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, copy.slotOffset, sampleCount * copy.elementSize); // One contiguous range
+        }
+        else {
+            for (int i = 0; i < sampleCount; ++i) {
+                GLintptr source = GLintptr(i) * sampleStride * copy.elementSize;
+                glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, source, copy.slotOffset + i * copy.elementSize, copy.elementSize);
+            }
+        }
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.frame = frame;
+    nextSlot = (nextSlot + 1) % slots.size();
+    ++pendingSlots;
+}
+
+void ParticleInspector::Poll(int frame, std::ostream& out) {
+    while (pendingSlots > 0) {
+        Slot& slot = slots[oldestSlot];
+        if (frame - slot.frame < readLatency) {
+            return; // Too recent, leave it for a later frame
+        }
+
+        // Zero timeout: only check the fence, never wait on it
+        GLenum status = glClientWaitSync(slot.fence, 0, 0);
+        if (status == GL_TIMEOUT_EXPIRED) {
+            return;
+        }
+        if (status == GL_WAIT_FAILED) {
+            std::cerr << "ERROR::INSPECTOR::FENCE_WAIT_FAILED" << std::endl;
+        }
+        glDeleteSync(slot.fence);
+        slot.fence = nullptr;
+
+        if (status != GL_WAIT_FAILED) {
+            if (persistent) {
+                Print(slot, slot.mapped, out);
+            }
+            else {
+                // The fence has signaled, so mapping here does not stall
+                glBindBuffer(GL_COPY_READ_BUFFER, slot.buffer);
+                void* data = glMapBufferRange(GL_COPY_READ_BUFFER, 0, slotSize, GL_MAP_READ_BIT);
+                if (data) {
+                    Print(slot, data, out);
+                    glUnmapBuffer(GL_COPY_READ_BUFFER);
+                }
+                glBindBuffer(GL_COPY_READ_BUFFER, 0);
+            }
+        }
+
+        slot.frame = -1;
+        oldestSlot = (oldestSlot + 1) % slots.size();
+        --pendingSlots;
+    }
+}
+
+void ParticleInspector::Print(const Slot& slot, const void* data, std::ostream& out) const {
+    // Put each sampled particle back together from its streams
+    std::vector<Particle> particleData(sampleCount);
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t s = 0; s < streamCopies.size(); ++s) {
+        particleStorage->DecodeStream(s, bytes + streamCopies[s].slotOffset, sampleCount, particleData.data());
+    }
+    particleStorage->ResolveLifetimes(sampleCount, sampleStride, particleData.data()); // From the emitter table as it is now
+
+    out << "Frame " << slot.frame;
+    if (droppedSamples > 0) {
+        out << " (" << droppedSamples << " samples dropped so far)";
+    }
+    out << '\n';
+    for (int i = 0; i < sampleCount; ++i) {
+        out << "Particle " << i * sampleStride << ": Pos(" << particleData[i].position.x << ", "
+            << particleData[i].position.y << "), Vel(" << particleData[i].velocity.x << ", "
+            << particleData[i].velocity.y << "), Age: " << particleData[i].age
+            << ", Lifetime: " << particleData[i].lifeTime << ", Respawns: " << particleData[i].respawnCount << '\n';
+    }
+}
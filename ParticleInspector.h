@@ -0,0 +1,58 @@
+#pragma once
+#include <glew.h>
+#include <ostream>
+#include <vector>
+#include <cstddef>
+#include "ParticleStorage.h"
+
+// Opt-in debug readback of a sampled subset of particles.
+// Each capture copies the sampled particles of every stream into one slot of a ring of staging buffers and fences it.
+// A slot is only read once its fence has signaled and it is at least `latency` frames old,
+// so the render loop never waits on the GPU.
+class ParticleInspector {
+public:
+    // count particles are sampled, every stride-th one starting at index 0, once every interval frames
+    bool Init(const ParticleStorage& storage, int count, int stride, int interval, int latency);
+    void Destroy();
+
+    bool Enabled() const { return sampleCount > 0; }
+    bool IsCaptureFrame(int frame) const { return Enabled() && frame % captureInterval == 0; }
+
+    // Queues a copy of the sampled particles out of the storage's target buffers, call after the frame's simulation.
+    // The caller makes the simulation's writes visible to the copy (GL_BUFFER_UPDATE_BARRIER_BIT).
+    void Capture(const ParticleStorage& storage, int frame);
+
+    // Prints every sample that is ready without blocking
+    void Poll(int frame, std::ostream& out);
+
+private:
+    struct Slot {
+        GLuint buffer = 0;
+        GLsync fence = nullptr;
+        void* mapped = nullptr; // Persistent mapping, null when buffer storage is unavailable
+        int frame = -1;         // Frame the slot was captured in, -1 when free
+    };
+
+    void Print(const Slot& slot, const void* data, std::ostream& out) const;
+
+    const ParticleStorage* particleStorage = nullptr; // Decodes the streams
+
+    // Where each stream's samples go in a slot; a slot holds the streams one after another
+    struct StreamCopy {
+        GLsizeiptr elementSize;
+        GLintptr slotOffset;
+    };
+
+    std::vector<StreamCopy> streamCopies;
+    GLsizeiptr slotSize = 0;
+    std::vector<Slot> slots;
+    size_t nextSlot = 0;       // Slot the next capture writes to
+    size_t oldestSlot = 0;     // Slot the next poll reads from
+    size_t pendingSlots = 0;   // Captured but not yet printed
+    size_t droppedSamples = 0; // Captures skipped because every slot was still in flight
+    int sampleCount = 0;
+    int sampleStride = 1;
+    int captureInterval = 1;
+    int readLatency = 3;
+    bool persistent = false;
+};
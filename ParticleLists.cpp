@@ -0,0 +1,84 @@
+#include "ParticleLists.h"
+#include <iostream>
+#include <numeric>
+#include <vector>
+#include <cstddef>
+
+bool ParticleLists::Init(GLsizei particleCount) {
+    current = 0;
+
+    ParticleListState state = {};
+    state.drawInstanceCount = 1;
+    state.nextAliveCount = static_cast<GLuint>(particleCount); // The first prepare pass makes it the alive count
+    glGenBuffers(1, &stateBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, stateBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(state), &state, GL_DYNAMIC_DRAW);
+
+    // Slot i is entry i of the first alive list
+    std::vector<GLuint> slots(particleCount);
+    std::iota(slots.begin(), slots.end(), 0u);
+    GLsizeiptr listSize = GLsizeiptr(particleCount) * sizeof(GLuint);
+    glGenBuffers(2, aliveBuffers);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, aliveBuffers[0]);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, listSize, slots.data(), GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, aliveBuffers[1]);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, listSize, nullptr, GL_DYNAMIC_DRAW);
+
+    glGenBuffers(1, &deadBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, deadBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, listSize, nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    if (glGetError() == GL_OUT_OF_MEMORY) {
+        std::cerr << "ERROR::PARTICLE_LISTS::OUT_OF_MEMORY" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void ParticleLists::Destroy() {
+    glDeleteBuffers(1, &stateBuffer);
+    glDeleteBuffers(2, aliveBuffers);
+    glDeleteBuffers(1, &deadBuffer);
+    stateBuffer = deadBuffer = 0;
+    aliveBuffers[0] = aliveBuffers[1] = 0;
+}
+
+void ParticleLists::ResolveBlocks(const ShaderProgram& program) {
+    stateBlock = program.GetStorageBlock("ParticleListState");
+    aliveInBlock = program.GetStorageBlock("AliveInBuffer");
+    aliveOutBlock = program.GetStorageBlock("AliveOutBuffer");
+    deadBlock = program.GetStorageBlock("DeadBuffer");
+}
+
+void ParticleLists::Bind() const {
+    stateBlock.Bind(stateBuffer);
+    aliveInBlock.Bind(CurrentAliveBuffer());
+    aliveOutBlock.Bind(NextAliveBuffer());
+    deadBlock.Bind(deadBuffer);
+}
+
+void ParticleLists::DispatchEmit() const {
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, stateBuffer);
+    glDispatchComputeIndirect(offsetof(ParticleListState, emitDispatch));
+}
+
+void ParticleLists::DispatchSimulate() const {
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, stateBuffer);
+    glDispatchComputeIndirect(offsetof(ParticleListState, simulateDispatch));
+}
+
+void ParticleLists::UpdateDrawCommand() const {
+    glBindBuffer(GL_COPY_READ_BUFFER, stateBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, stateBuffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, offsetof(ParticleListState, nextAliveCount), offsetof(ParticleListState, drawCount), sizeof(GLuint));
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void ParticleLists::Draw(GLuint indexBuffer) const {
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer); // Recorded in the bound VAO
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, stateBuffer);
+    glDrawElementsIndirect(GL_POINTS, GL_UNSIGNED_INT, reinterpret_cast<const void*>(offsetof(ParticleListState, drawCount)));
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
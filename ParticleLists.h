@@ -0,0 +1,69 @@
+#pragma once
+#include <glew.h>
+#include <string>
+#include <vector>
+#include "ShaderProgram.h"
+
+// Mirrors ParticleListState in compute_shader.glsl and list_prepare_shader.glsl
+struct ParticleListState {
+    GLuint emitDispatch[3];     // glDispatchComputeIndirect arguments of the emit pass
+    GLuint simulateDispatch[3]; // ... and of the simulate pass
+    GLuint drawCount;           // glDrawElementsIndirect arguments
+    GLuint drawInstanceCount;
+    GLuint drawFirstIndex;
+    GLint drawBaseVertex;
+    GLuint drawBaseInstance;
+    GLuint aliveCount;          // Entries of the current alive list
+    GLuint nextAliveCount;      // Entries appended to the next alive list this frame
+    GLuint deadCount;           // Entries of the dead list
+    GLuint emitCount;           // Slots popped off the dead list this frame
+    GLuint emitBase;            // First of them
+};
+
+static_assert(sizeof(ParticleListState) == 64, "ParticleListState must match the std430 block");
+
+// Alive and dead lists of particle slots for the pooled mode, kept entirely on the GPU.
+// Each frame a one-thread prepare pass pops the emitter's request off the dead list and writes the
+// dispatch arguments; the emit pass revives the popped slots, the simulate pass walks the current alive
+// list, pushes deaths onto the dead list and appends survivors to the next alive list. The draw uses the
+// next alive list as its index buffer, with the count copied on the GPU. Nothing is read back.
+class ParticleLists {
+public:
+    // Every slot starts alive, the dead list starts empty
+    bool Init(GLsizei particleCount);
+    void Destroy();
+
+    // Turns on the list-driven paths of compute_shader.glsl
+    static ShaderDefines Defines() { return ShaderDefines().Set("PARTICLE_LISTS"); }
+    // Storage bindings of the list state, the alive lists and the dead list in the programs using them
+    static std::vector<GLuint> StorageBindings() { return { 9, 10, 11, 12 }; }
+
+    // The blocks have fixed bindings, any program using them resolves the same ones
+    void ResolveBlocks(const ShaderProgram& program);
+    void Bind() const;
+
+    GLuint StateBuffer() const { return stateBuffer; }
+    GLuint CurrentAliveBuffer() const { return aliveBuffers[current]; }
+    GLuint NextAliveBuffer() const { return aliveBuffers[1 - current]; }
+    GLuint DeadBuffer() const { return deadBuffer; }
+
+    void DispatchEmit() const;
+    void DispatchSimulate() const;
+
+    // Copies the final alive count into the draw arguments
+    void UpdateDrawCommand() const;
+
+    // Draws the next alive list's slots, the particle VAO must be bound. indexBuffer holds the slots to draw,
+    // the next alive list itself or a reordering of it with at least as many entries.
+    void Draw(GLuint indexBuffer) const;
+
+    // The next alive list becomes the current one, call once the frame's draw has been queued
+    void Swap() { current = 1 - current; }
+
+private:
+    GLuint stateBuffer = 0;
+    GLuint aliveBuffers[2] = { 0, 0 };
+    GLuint deadBuffer = 0;
+    int current = 0;
+    BufferBlock stateBlock, aliveInBlock, aliveOutBlock, deadBlock;
+};
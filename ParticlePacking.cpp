@@ -0,0 +1,80 @@
+#include "ParticlePacking.h"
+#include "ParticleRandom.h"
+#include <packing.hpp>
+#include <geometric.hpp>
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+PackedParticle PackParticle(const Particle& particle) {
+    PackedParticle packed;
+    packed.position = particle.position;
+    packed.velocity = glm::packHalf2x16(particle.velocity);
+    packed.color = glm::packUnorm4x8(particle.color);
+    float ageFraction = particle.lifeTime > 0.0f ? particle.age / particle.lifeTime : 0.0f;
+    packed.ageRespawn = (glm::packUnorm2x16(glm::vec2(ageFraction, 0.0f)) & 0xFFFFu) | (particle.respawnCount << 16);
+    return packed;
+}
+
+Particle UnpackParticle(const PackedParticle& packed, float lifeTime) {
+    Particle particle = {};
+    particle.position = packed.position;
+    particle.velocity = glm::unpackHalf2x16(packed.velocity);
+    particle.color = glm::unpackUnorm4x8(packed.color);
+    particle.respawnCount = packed.ageRespawn >> 16;
+    particle.lifeTime = lifeTime;
+    particle.age = glm::unpackUnorm2x16(packed.ageRespawn).x * particle.lifeTime;
+    return particle;
+}
+
+PackingError PackingErrorBudget() {
+    const float slack = 1e-6f; // Float rounding in the encode and decode themselves, relative to the field's range
+    PackingError budget;
+    budget.position = 0.0f;
+    budget.velocity = 1.0f / 2048.0f + slack;
+    budget.color = 0.5f / 255.0f + slack;
+    budget.lifeTime = 0.0f; // Derived, not stored
+    budget.age = (0.5f / 65535.0f + slack) * PARTICLE_MAX_LIFETIME;
+    return budget;
+}
+
+PackingError MeasurePackingError(const std::vector<Particle>& particles, uint32_t seed, const std::vector<EmitterParams>* emitters) {
+    PackingError error;
+    for (size_t i = 0; i < particles.size(); ++i) {
+        const Particle& particle = particles[i];
+        uint32_t id = static_cast<uint32_t>(i);
+        PackedParticle packed = PackParticle(particle);
+        uint32_t respawnCount = packed.ageRespawn >> 16;
+        float lifeTime = emitters ? EmitterLifetime((*emitters)[particle.emitter], seed, id, respawnCount) : ParticleLifetime(seed, id, respawnCount);
+        Particle roundTrip = UnpackParticle(packed, lifeTime);
+        glm::vec2 positionError = glm::abs(roundTrip.position - particle.position);
+        glm::vec2 velocityError = glm::abs(roundTrip.velocity - particle.velocity);
+        glm::vec4 colorError = glm::abs(roundTrip.color - particle.color);
+        float speed = glm::length(particle.velocity);
+
+        error.position = std::max(error.position, std::max(positionError.x, positionError.y));
+        if (speed > 0.0f) {
+            error.velocity = std::max(error.velocity, std::max(velocityError.x, velocityError.y) / speed);
+        }
+        error.color = std::max({ error.color, colorError.r, colorError.g, colorError.b, colorError.a });
+        error.age = std::max(error.age, std::abs(roundTrip.age - particle.age));
+        error.lifeTime = std::max(error.lifeTime, std::abs(roundTrip.lifeTime - particle.lifeTime));
+    }
+    return error;
+}
+
+bool CheckPackingError(const PackingError& error, const PackingError& budget) {
+    bool withinBudget = true;
+    auto check = [&](const char* field, float value, float limit) {
+        if (value > limit) {
+            std::cerr << "ERROR::PACKING::OVER_BUDGET " << field << " error " << value << " exceeds " << limit << std::endl;
+            withinBudget = false;
+        }
+    };
+    check("position", error.position, budget.position);
+    check("velocity", error.velocity, budget.velocity);
+    check("color", error.color, budget.color);
+    check("age", error.age, budget.age);
+    check("lifetime", error.lifeTime, budget.lifeTime);
+    return withinBudget;
+}
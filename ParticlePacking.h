@@ -0,0 +1,32 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "Particle.h"
+#include "ParticleEmitters.h"
+
+// Host side of the packed layout, encodes exactly like the pack/unpack built-ins in compute_shader.glsl.
+// The respawn count keeps its low 16 bits. The lifetime is not stored, unpacking takes the particle's
+// (derived from the respawn count, the seed, the particle id and its emitter) to scale the age fraction by.
+// The emitter index lives in a stream of its own and is left at 0.
+PackedParticle PackParticle(const Particle& particle);
+Particle UnpackParticle(const PackedParticle& packed, float lifeTime);
+
+// Largest difference packing may introduce in each field compared to the float Particle
+struct PackingError {
+    float position = 0.0f;
+    float velocity = 0.0f; // Relative to the velocity's magnitude
+    float color = 0.0f;
+    float age = 0.0f;      // Seconds
+    float lifeTime = 0.0f; // Seconds
+};
+
+// What the packed formats guarantee: half float keeps 11 significant bits, unorm rounds to the nearest step,
+// the derived lifetime is exact
+PackingError PackingErrorBudget();
+
+// Round-trips every particle through the packed format and measures the error against the float path,
+// deriving the lifetime the way the shader does. emitters is the emitter table, null without one.
+PackingError MeasurePackingError(const std::vector<Particle>& particles, uint32_t seed, const std::vector<EmitterParams>* emitters);
+
+// Prints every field that is over budget, returns false if any is
+bool CheckPackingError(const PackingError& error, const PackingError& budget);
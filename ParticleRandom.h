@@ -0,0 +1,50 @@
+#pragma once
+#include <glm.hpp>
+#include <cstdint>
+
+// Counter-based RNG shared with compute_shader.glsl. Every value is a pure function of (seed, particle id,
+// counter): the pcg3d hash (Jarzynski & Olano, "Hash Functions for GPU Rendering") of the three keys.
+// There is no state to carry between frames, so the GPU, the CPU backend and the validation reference
+// draw exactly the same numbers. Only 32-bit integer multiplies, adds, xors and shifts are used,
+// which every backend computes identically. Keep the two implementations in sync.
+
+// Counter used for the values only drawn at init; respawn counts never get this far
+const uint32_t PARTICLE_RANDOM_INIT_COUNTER = 0xFFFFFFFFu;
+
+// Longest lifetime ParticleLifetime() can return, in seconds
+const float PARTICLE_MAX_LIFETIME = 5.0f;
+
+inline glm::uvec3 ParticleRandom(uint32_t seed, uint32_t id, uint32_t counter) {
+    glm::uvec3 v(id, counter, seed);
+    v = v * 1664525u + 1013904223u;
+    v.x += v.y * v.z;
+    v.y += v.z * v.x;
+    v.z += v.x * v.y;
+    v ^= v >> 16u;
+    v.x += v.y * v.z;
+    v.y += v.z * v.x;
+    v.z += v.x * v.y;
+    return v;
+}
+
+// Uniform in [0, 1) from the top 22 bits. Scaling it by a range with at most two significant bits
+// (1.5, 2, 4) is exact, so a fused multiply-add on the GPU rounds the same as separate operations on the CPU
+inline float RandomUnit(uint32_t bits) {
+    return float(bits >> 10) * (1.0f / 4194304.0f);
+}
+
+// Lifetime of a particle's life number respawnCount: the first one in [1.5, 3) seconds, respawns in [1, 5)
+inline float ParticleLifetime(uint32_t seed, uint32_t id, uint32_t respawnCount) {
+    float t = RandomUnit(ParticleRandom(seed, id, respawnCount).x);
+    return respawnCount == 0u ? 1.5f + 1.5f * t : 1.0f + 4.0f * t;
+}
+
+// Speed every particle is launched with, in NDC units per second
+const float PARTICLE_LAUNCH_SPEED = 0.2f + 0.005f;
+
+// Velocity of a particle at launch and, when forces change velocities, again at every respawn
+inline glm::vec2 ParticleLaunchVelocity(uint32_t seed, uint32_t id) {
+    glm::uvec3 bits = ParticleRandom(seed, id, 0); // x is the first lifetime
+    glm::vec2 direction(RandomUnit(bits.y) * 2.0f - 1.0f, RandomUnit(bits.z) * 2.0f - 1.0f);
+    return glm::normalize(direction) * PARTICLE_LAUNCH_SPEED;
+}
@@ -0,0 +1,322 @@
+#include "ParticleStorage.h"
+#include "ParticlePacking.h"
+#include "ParticleRandom.h"
+#include <algorithm>
+#include <iostream>
+#include <cstring>
+#include <cstddef>
+
+bool ParticleStorage::Init(const std::vector<Particle>& initialParticles, ParticleLayout particleLayout, bool usePingPong, bool dynamicVelocity, const std::vector<EmitterParams>* emitterTable, uint32_t randomSeed) {
+    layout = particleLayout;
+    pingPong = usePingPong;
+    emitters = emitterTable;
+    seed = randomSeed;
+    particleCount = static_cast<GLsizei>(initialParticles.size());
+    source = 0;
+
+    streams.clear();
+    vertexAttributes.clear();
+    auto addStream = [&](const char* name, GLsizeiptr elementSize, size_t particleOffset, bool simulated) {
+        ParticleStream stream;
+        stream.name = name;
+        stream.elementSize = elementSize;
+        stream.particleOffset = particleOffset;
+        stream.simulated = simulated;
+        stream.emitted = false;
+        streams.push_back(stream);
+    };
+
+    switch (layout) {
+    case ParticleLayout::AoS:
+        addStream("Particle", sizeof(Particle), 0, true);
+        vertexAttributes.push_back({ 0, 0, 2, GL_FLOAT, GL_FALSE, offsetof(Particle, position) }); // Position
+        vertexAttributes.push_back({ 1, 0, 4, GL_FLOAT, GL_FALSE, offsetof(Particle, color) });    // Color
+        break;
+    case ParticleLayout::SoA:
+        addStream("Position", sizeof(glm::vec2), offsetof(Particle, position), true);
+        addStream("Velocity", sizeof(glm::vec2), offsetof(Particle, velocity), dynamicVelocity); // Without forces it never changes after init
+        addStream("Color", sizeof(glm::vec4), offsetof(Particle, color), true);
+        addStream("Age", sizeof(float), offsetof(Particle, age), true);
+        addStream("RespawnCount", sizeof(glm::uint), offsetof(Particle, respawnCount), true); // The lifetime is derived from it
+        vertexAttributes.push_back({ 0, 0, 2, GL_FLOAT, GL_FALSE, 0 }); // Position
+        vertexAttributes.push_back({ 1, 2, 4, GL_FLOAT, GL_FALSE, 0 }); // Color
+        break;
+    case ParticleLayout::Packed:
+        addStream("PackedParticle", sizeof(PackedParticle), 0, true);
+        vertexAttributes.push_back({ 0, 0, 2, GL_FLOAT, GL_FALSE, offsetof(PackedParticle, position) }); // Position
+        vertexAttributes.push_back({ 1, 0, 4, GL_UNSIGNED_BYTE, GL_TRUE, offsetof(PackedParticle, color) }); // RGBA8, normalized by the vertex fetch
+        break;
+    }
+    if (emitters && layout != ParticleLayout::AoS) {
+        addStream("EmitterIndex", sizeof(glm::uint), offsetof(Particle, emitter), false); // The AoS record has the field
+        streams.back().emitted = true;
+    }
+
+    // Large particle counts can exceed what the driver allows in one storage block
+    GLint64 maxStorageBlockSize = 0;
+    glGetInteger64v(GL_MAX_SHADER_STORAGE_BLOCK_SIZE, &maxStorageBlockSize);
+    for (const ParticleStream& stream : streams) {
+        GLint64 size = GLint64(particleCount) * stream.elementSize;
+        if (size > maxStorageBlockSize) {
+            std::cerr << "ERROR::SSBO::TOO_LARGE " << stream.name << " needs " << size << " bytes, the limit is " << maxStorageBlockSize << std::endl;
+            return false;
+        }
+    }
+
+    // Uploaded a few MiB at a time: the staging copy stays small however many particles there are, and the
+    // driver can copy the first chunks into the buffer while later ones are still being gathered
+    const size_t UPLOAD_CHUNK_BYTES = size_t(4) << 20;
+    std::vector<unsigned char> streamData;
+    std::vector<PackedParticle> packedParticles;
+    for (ParticleStream& stream : streams) {
+        GLsizeiptr size = GLsizeiptr(particleCount) * stream.elementSize;
+        int bufferCount = pingPong && stream.simulated ? 2 : 1;
+        glGenBuffers(bufferCount, stream.buffers); // Create SSBO(s)
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, stream.buffers[0]);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, size, nullptr, GL_DYNAMIC_DRAW); // Allocate memory for SSBO
+
+        const size_t chunkParticles = std::max<size_t>(1, UPLOAD_CHUNK_BYTES / size_t(stream.elementSize));
+        for (size_t first = 0; first < size_t(particleCount); first += chunkParticles) {
+            const size_t count = std::min(chunkParticles, size_t(particleCount) - first);
+            const Particle* chunk = initialParticles.data() + first;
+
+            // Gather this stream's slice of the chunk's particles
+            const void* data = chunk;
+            if (layout == ParticleLayout::Packed && stream.particleOffset == 0) {
+                packedParticles.resize(count);
+                for (size_t i = 0; i < count; ++i) {
+                    packedParticles[i] = PackParticle(chunk[i]);
+                }
+                data = packedParticles.data();
+            }
+            else if (stream.elementSize != sizeof(Particle)) {
+                streamData.resize(count * stream.elementSize);
+                for (size_t i = 0; i < count; ++i) {
+                    std::memcpy(&streamData[i * stream.elementSize], reinterpret_cast<const unsigned char*>(&chunk[i]) + stream.particleOffset, stream.elementSize);
+                }
+                data = streamData.data();
+            }
+            glBufferSubData(GL_SHADER_STORAGE_BUFFER, GLintptr(first * stream.elementSize), GLsizeiptr(count * stream.elementSize), data);
+        }
+
+        if (bufferCount == 2) {
+            // Every particle is rewritten by the first dispatch, the second buffer needs no initial data
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, stream.buffers[1]);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+        }
+        else {
+            stream.buffers[1] = stream.buffers[0];
+        }
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    if (glGetError() == GL_OUT_OF_MEMORY) {
+        std::cerr << "ERROR::SSBO::OUT_OF_MEMORY" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void ParticleStorage::Destroy() {
+    for (int i = 0; i < 2; ++i) {
+        if (readFences[i]) {
+            glDeleteSync(readFences[i]);
+            readFences[i] = nullptr;
+        }
+    }
+    for (ParticleStream& stream : streams) {
+        glDeleteBuffers(stream.buffers[1] != stream.buffers[0] ? 2 : 1, stream.buffers);
+    }
+    streams.clear();
+    particleCount = 0;
+}
+
+ShaderDefines ParticleStorage::LayoutDefines(ParticleLayout layout, GLsizei count) {
+    ShaderDefines defines;
+    if (layout == ParticleLayout::SoA) {
+        defines.Set("PARTICLE_LAYOUT_SOA");
+    }
+    else if (layout == ParticleLayout::Packed) {
+        defines.Set("PARTICLE_LAYOUT_PACKED");
+    }
+    defines.Set("PARTICLE_COUNT", std::to_string(count) + "u"); // Lets the compiler fold the bounds checks
+    return defines;
+}
+
+ShaderDefines ParticleStorage::SimulationDefines(ParticleLayout layout, GLsizei count, bool pingPong, bool dynamicVelocity) {
+    ShaderDefines defines = LayoutDefines(layout, count);
+    if (pingPong) {
+        defines.Set("PING_PONG"); // Read from one buffer, write the other
+    }
+    if (dynamicVelocity) {
+        defines.Set("DYNAMIC_VELOCITY"); // Velocity is written back, the SoA layout double-buffers it with ping-pong
+    }
+    return defines;
+}
+
+std::vector<GLuint> ParticleStorage::StreamBindings(ParticleLayout layout, bool pingPong, bool dynamicVelocity, bool emitters) {
+    std::vector<GLuint> bindings;
+    switch (layout) {
+    case ParticleLayout::SoA:
+        bindings = { 0, 1, 2, 3, 4 }; // Position, velocity, color, age, respawn count
+        if (pingPong) {
+            bindings.insert(bindings.end(), { 5, 6, 7, 8 }); // Every one but the velocity has its output buffer
+            if (dynamicVelocity) {
+                bindings.push_back(15);
+            }
+        }
+        break;
+    case ParticleLayout::AoS:
+    case ParticleLayout::Packed:
+        bindings = { 0 };
+        if (pingPong) {
+            bindings.push_back(1);
+        }
+        break;
+    }
+    if (emitters && layout != ParticleLayout::AoS) {
+        bindings.push_back(18);
+    }
+    return bindings;
+}
+
+void ParticleStorage::ResolveBlocks(const ShaderProgram& computeProgram) {
+    for (ParticleStream& stream : streams) {
+        if (pingPong && stream.simulated) {
+            stream.inBlock = computeProgram.GetStorageBlock(stream.name + "InBuffer");
+            stream.outBlock = computeProgram.GetStorageBlock(stream.name + "OutBuffer");
+        }
+        else {
+            stream.inBlock = computeProgram.GetStorageBlock(stream.name + "Buffer");
+            stream.outBlock = stream.inBlock;
+        }
+    }
+}
+
+void ParticleStorage::ResolveReadBlocks(const ShaderProgram& program) {
+    for (ParticleStream& stream : streams) {
+        stream.readBlock = program.HasStorageBlock(stream.name + "Buffer") ? program.GetStorageBlock(stream.name + "Buffer") : BufferBlock();
+    }
+}
+
+GLuint ParticleStorage::TargetBuffer(size_t stream) const {
+    return streams[stream].buffers[pingPong ? 1 - source : source];
+}
+
+void ParticleStorage::BindForSimulation() const {
+    for (size_t i = 0; i < streams.size(); ++i) {
+        streams[i].inBlock.Bind(SourceBuffer(i));
+        if (streams[i].outBlock.Binding() != streams[i].inBlock.Binding()) {
+            streams[i].outBlock.Bind(TargetBuffer(i));
+        }
+    }
+}
+
+void ParticleStorage::BindForReading() const {
+    for (size_t i = 0; i < streams.size(); ++i) {
+        streams[i].readBlock.Bind(TargetBuffer(i));
+    }
+}
+
+void ParticleStorage::SetupVertexArray(GLuint vao) const {
+    glBindVertexArray(vao);
+    for (const VertexAttribute& attribute : vertexAttributes) {
+        glEnableVertexAttribArray(attribute.index);
+        glVertexAttribFormat(attribute.index, attribute.size, attribute.type, attribute.normalized, attribute.offset);
+        glVertexAttribBinding(attribute.index, static_cast<GLuint>(attribute.stream));
+    }
+    glBindVertexArray(0);
+    BindVertexBuffers(vao);
+}
+
+void ParticleStorage::BindVertexBuffers(GLuint vao) const {
+    glBindVertexArray(vao);
+    for (const VertexAttribute& attribute : vertexAttributes) {
+        const ParticleStream& stream = streams[attribute.stream];
+        glBindVertexBuffer(static_cast<GLuint>(attribute.stream), TargetBuffer(attribute.stream), 0, static_cast<GLsizei>(stream.elementSize));
+    }
+}
+
+bool ParticleStorage::IsVertexSource(size_t stream) const {
+    for (const VertexAttribute& attribute : vertexAttributes) {
+        if (attribute.stream == stream) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ParticleStorage::DecodeStream(size_t stream, const void* data, size_t count, Particle* particles) const {
+    const ParticleStream& source = streams[stream];
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < count; ++i) {
+        if (layout == ParticleLayout::Packed && source.particleOffset == 0) {
+            PackedParticle record;
+            std::memcpy(&record, bytes + i * source.elementSize, sizeof(record));
+            uint32_t emitter = particles[i].emitter; // The emitter stream may have been decoded first
+            particles[i] = UnpackParticle(record, 1.0f); // Age as a fraction until the lifetime is known
+            particles[i].emitter = emitter;
+        }
+        else {
+            std::memcpy(reinterpret_cast<unsigned char*>(&particles[i]) + source.particleOffset, bytes + i * source.elementSize, source.elementSize);
+        }
+    }
+}
+
+void ParticleStorage::ResolveLifetimes(size_t count, size_t idStride, Particle* particles) const {
+    if (layout == ParticleLayout::AoS) {
+        return; // Stored
+    }
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t id = static_cast<uint32_t>(i * idStride);
+        Particle& particle = particles[i];
+        if (emitters) {
+            particle.lifeTime = EmitterLifetime((*emitters)[particle.emitter], seed, id, particle.respawnCount);
+        }
+        else {
+            particle.lifeTime = ParticleLifetime(seed, id, particle.respawnCount);
+        }
+        if (layout == ParticleLayout::Packed) {
+            particle.age *= particle.lifeTime;
+        }
+    }
+}
+
+void ParticleStorage::ReadParticles(std::vector<Particle>& particles) const {
+    particles.assign(particleCount, Particle());
+    std::vector<unsigned char> data;
+    for (size_t s = 0; s < streams.size(); ++s) {
+        data.resize(size_t(particleCount) * streams[s].elementSize);
+        glBindBuffer(GL_COPY_READ_BUFFER, TargetBuffer(s));
+        glGetBufferSubData(GL_COPY_READ_BUFFER, 0, data.size(), data.data());
+        DecodeStream(s, data.data(), particleCount, particles.data());
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    ResolveLifetimes(particleCount, 1, particles.data());
+}
+
+void ParticleStorage::AcquireTarget() {
+    if (!pingPong) {
+        return;
+    }
+    int target = 1 - source;
+    if (readFences[target]) {
+        glWaitSync(readFences[target], 0, GL_TIMEOUT_IGNORED); // Server-side wait, the CPU keeps going
+        glDeleteSync(readFences[target]);
+        readFences[target] = nullptr;
+    }
+}
+
+void ParticleStorage::ReleaseSource() {
+    if (!pingPong) {
+        return;
+    }
+    // The draw of these buffers was queued last frame and the dispatch just read them, nothing else will
+    readFences[source] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void ParticleStorage::Swap() {
+    if (pingPong) {
+        source = 1 - source;
+    }
+}
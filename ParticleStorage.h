@@ -0,0 +1,108 @@
+#pragma once
+#include <glew.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Particle.h"
+#include "ParticleEmitters.h"
+#include "ShaderProgram.h"
+
+// One GPU buffer (or ping-pong pair) holding one slice of every particle
+struct ParticleStream {
+    std::string name;          // Storage blocks are named <name>Buffer, or <name>InBuffer / <name>OutBuffer with ping-pong
+    GLsizeiptr elementSize;    // Bytes per particle in this stream
+    size_t particleOffset;     // Where the element lives inside struct Particle, 0 for whole records
+    bool simulated;            // Written by the simulation; read-only streams are never double-buffered
+    bool emitted;              // Only written by the pooled emit pass, in place: it changes dead slots nothing reads
+    GLuint buffers[2] = { 0, 0 };
+    BufferBlock inBlock;       // Where the simulation reads the stream
+    BufferBlock outBlock;      // Where the simulation writes it, same as inBlock without ping-pong
+    BufferBlock readBlock;     // Where passes reading the frame's result find it, unset if their program does not use the stream
+};
+
+// GPU particle state in the selected layout. In ping-pong mode every simulated stream has two buffers:
+// the simulation reads last frame's state from one and writes the new state into the other, which the
+// draw then consumes. Compute for the next frame therefore only reads what the previous draw reads, and
+// drivers can overlap the two. A fence per buffer set marks when its last reader has been submitted; the
+// next write to it waits on the fence on the server, never on the CPU.
+class ParticleStorage {
+public:
+    // seed is the RNG seed the particles were created with, layouts that derive the lifetime need it.
+    // dynamicVelocity makes the velocity simulated state, needed once forces act on the particles.
+    // emitters is the host copy of the emitter table, null without one; with it the SoA and packed
+    // layouts get a stream of emitter indices and derive lifetimes from their emitter's range.
+    bool Init(const std::vector<Particle>& initialParticles, ParticleLayout layout, bool pingPong, bool dynamicVelocity, const std::vector<EmitterParams>* emitters, uint32_t seed);
+    void Destroy();
+
+    ParticleLayout Layout() const { return layout; }
+    bool PingPong() const { return pingPong; }
+    GLsizei Count() const { return particleCount; }
+    const std::vector<ParticleStream>& Streams() const { return streams; }
+
+    // Defines the compute shader needs for a layout and particle count; known before Init() so the
+    // programs can compile while the buffers are filled
+    static ShaderDefines SimulationDefines(ParticleLayout layout, GLsizei count, bool pingPong, bool dynamicVelocity);
+    // The same without PING_PONG, for variants that only read the frame's result
+    static ShaderDefines LayoutDefines(ParticleLayout layout, GLsizei count);
+    // Storage bindings compute_shader.glsl declares for the streams of such a variant, emitters adds the
+    // emitter index stream of the SoA and packed layouts
+    static std::vector<GLuint> StreamBindings(ParticleLayout layout, bool pingPong, bool dynamicVelocity, bool emitters);
+
+    // Looks up the storage blocks of every stream in the compute program
+    void ResolveBlocks(const ShaderProgram& computeProgram);
+    // Looks up the <name>Buffer blocks of a program built with LayoutDefines()
+    void ResolveReadBlocks(const ShaderProgram& program);
+
+    // Buffer holding the last simulated state of a stream, read by the simulation
+    GLuint SourceBuffer(size_t stream) const { return streams[stream].buffers[source]; }
+    // Buffer the simulation writes and the draw reads; the same as SourceBuffer without ping-pong
+    GLuint TargetBuffer(size_t stream) const;
+
+    // Binds source and target buffers to the compute program's storage blocks
+    void BindForSimulation() const;
+    // Binds the target buffers to the blocks found by ResolveReadBlocks
+    void BindForReading() const;
+
+    // Sets up vertex attributes 0 (position) and 1 (color) of vao, and points them at the target buffers
+    void SetupVertexArray(GLuint vao) const;
+    void BindVertexBuffers(GLuint vao) const;
+    bool IsVertexSource(size_t stream) const;
+
+    // Fills the stream's part of count particles from count tightly packed elements of that stream
+    void DecodeStream(size_t stream, const void* data, size_t count, Particle* particles) const;
+    // Completes particles once every stream is decoded: layouts that derive the lifetime need the respawn
+    // count and the emitter, and the packed age is stored as a fraction of the lifetime.
+    // Element i belongs to particle i * idStride.
+    void ResolveLifetimes(size_t count, size_t idStride, Particle* particles) const;
+
+    // Reads the target buffers back into Particle records, waits for the GPU
+    void ReadParticles(std::vector<Particle>& particles) const;
+
+    // Makes the server wait until the target buffers' last reader has finished, call before the dispatch
+    void AcquireTarget();
+    // Fences the source buffers, call right after the dispatch that read them for the last time
+    void ReleaseSource();
+    // Swaps the roles of the two buffer sets, call once the frame's draw has been queued
+    void Swap();
+
+private:
+    // Vertex attribute sourced from a stream; the stream index doubles as the vertex buffer binding
+    struct VertexAttribute {
+        GLuint index;
+        size_t stream;
+        GLint size;
+        GLenum type;
+        GLboolean normalized;
+        GLuint offset;
+    };
+
+    std::vector<ParticleStream> streams;
+    std::vector<VertexAttribute> vertexAttributes;
+    GLsync readFences[2] = { nullptr, nullptr }; // Signaled once the buffer set's last queued reader is done
+    ParticleLayout layout = ParticleLayout::AoS;
+    bool pingPong = false;
+    int source = 0;
+    GLsizei particleCount = 0;
+    uint32_t seed = 0;
+    const std::vector<EmitterParams>* emitters = nullptr;
+};
@@ -0,0 +1,101 @@
+#include "ProgramBinaryCache.h"
+#include "ShaderProgram.h"
+#include "CacheFile.h"
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <cctype>
+
+// Written in front of every binary, a mismatch means the file is not ours or was cut short
+struct ProgramBinaryHeader {
+    char magic[8];
+    uint32_t format;
+    uint32_t length;
+};
+
+static const char PROGRAM_BINARY_MAGIC[8] = { 'S', 'L', 'P', 'B', 'I', 'N', '0', '1' };
+
+static std::string GlString(GLenum name) {
+    const GLubyte* value = glGetString(name);
+    return value ? reinterpret_cast<const char*>(value) : "";
+}
+
+bool ProgramBinaryCache::Init(const std::string& directory) {
+    enabled = false;
+    GLint formatCount = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+    if (formatCount == 0) {
+        std::cerr << "Shader cache disabled, the driver offers no program binary format" << std::endl;
+        return false;
+    }
+
+    if (!MakeCacheDirectory(directory)) {
+        std::cerr << "ERROR::SHADER_CACHE::DIRECTORY " << directory << std::endl;
+        return false;
+    }
+
+    cacheDirectory = directory;
+    driverIdentity = GlString(GL_VENDOR) + "\n" + GlString(GL_RENDERER) + "\n" + GlString(GL_VERSION) + "\n";
+    enabled = true;
+    return true;
+}
+
+std::string ProgramBinaryCache::Key(const std::string& programName, const std::vector<ShaderStageSource>& stages) const {
+    uint64_t hash = Fnv1a(driverIdentity);
+    for (const ShaderStageSource& stage : stages) {
+        hash = Fnv1a(std::to_string(stage.type) + "\n", hash);
+        hash = Fnv1a(stage.source, hash);
+    }
+
+    // Readable prefix for whoever looks into the directory, the hash alone identifies the entry
+    std::string key;
+    for (char c : programName) {
+        key += std::isalnum(static_cast<unsigned char>(c)) ? c : '_';
+    }
+    return key + "-" + HashHex(hash);
+}
+
+std::string ProgramBinaryCache::Path(const std::string& key) const {
+    return cacheDirectory + "/" + key + ".bin";
+}
+
+bool ProgramBinaryCache::Load(const std::string& key, GLenum& format, std::vector<char>& binary) {
+    if (!enabled) {
+        return false;
+    }
+    std::ifstream file(Path(key), std::ios::binary);
+    ProgramBinaryHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, PROGRAM_BINARY_MAGIC, sizeof(header.magic)) != 0) {
+        return false;
+    }
+    binary.resize(header.length);
+    if (!file.read(binary.data(), header.length) || file.peek() != std::ifstream::traits_type::eof()) {
+        return false;
+    }
+    format = header.format;
+    return true;
+}
+
+void ProgramBinaryCache::Store(const std::string& key, GLuint program) {
+    if (!enabled) {
+        return;
+    }
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(program, length, &length, &format, binary.data());
+
+    ProgramBinaryHeader header;
+    std::memcpy(header.magic, PROGRAM_BINARY_MAGIC, sizeof(header.magic));
+    header.format = format;
+    header.length = static_cast<uint32_t>(length);
+
+    if (!WriteCacheFile(Path(key), &header, sizeof(header), binary.data(), size_t(length))) {
+        std::cerr << "ERROR::SHADER_CACHE::WRITE_FAILED " << Path(key) << std::endl;
+    }
+}
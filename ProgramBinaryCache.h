@@ -0,0 +1,44 @@
+#pragma once
+#include <glew.h>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct ShaderStageSource;
+
+// On-disk cache of linked program binaries (glGetProgramBinary / glProgramBinary).
+// An entry is keyed by a hash of every stage's final source, which includes the injected defines,
+// and of GL_VENDOR, GL_RENDERER and GL_VERSION, so a driver update never loads a stale binary.
+// Drivers may still reject a binary they wrote; the caller then compiles from source and stores again.
+// Load and Store only touch files, they are safe to call from the hot-reload worker as well.
+class ProgramBinaryCache {
+public:
+    // Needs a current context; returns false and leaves the cache disabled when the driver offers no binary format
+    bool Init(const std::string& directory);
+    bool Enabled() const { return enabled; }
+
+    std::string Key(const std::string& programName, const std::vector<ShaderStageSource>& stages) const;
+
+    bool Load(const std::string& key, GLenum& format, std::vector<char>& binary);
+    // program must have been linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set
+    void Store(const std::string& key, GLuint program);
+
+    // Outcome of a cached build, for the startup report
+    void CountHit() { ++hits; }
+    void CountMiss() { ++misses; }
+    void CountRejected() { ++rejected; }
+    int Hits() const { return hits; }
+    int Misses() const { return misses; }
+    int Rejected() const { return rejected; }
+
+private:
+    std::string Path(const std::string& key) const;
+
+    std::string cacheDirectory;
+    std::string driverIdentity; // Vendor, renderer and version, part of every key
+    bool enabled = false;
+    std::atomic<int> hits{ 0 };
+    std::atomic<int> misses{ 0 };
+    std::atomic<int> rejected{ 0 };
+};
@@ -0,0 +1,202 @@
+#include "RadixSort.h"
+#include "ComputeDispatch.h"
+#include <iostream>
+#include <string>
+#include <algorithm>
+
+bool RadixSort::Init(size_t count, ShaderVariantCache& programs) {
+    maxCount = count;
+
+    if (!RequestStage(histogram, programs, "RADIX_HISTOGRAM") ||
+        !RequestStage(scatter, programs, "RADIX_SCATTER") ||
+        !RequestStage(scanBlocks, programs, "SCAN_BLOCKS") ||
+        !RequestStage(scanAdd, programs, "SCAN_ADD")) {
+        return false;
+    }
+
+    GLint64 maxStorageBlockSize = 0;
+    glGetInteger64v(GL_MAX_SHADER_STORAGE_BLOCK_SIZE, &maxStorageBlockSize);
+    GLsizeiptr pairSize = GLsizeiptr(std::max<size_t>(maxCount, 1)) * sizeof(GLuint);
+    if (pairSize > maxStorageBlockSize) {
+        std::cerr << "ERROR::RADIX_SORT::TOO_LARGE " << maxCount << " keys need " << pairSize << " bytes, the limit is " << maxStorageBlockSize << std::endl;
+        return false;
+    }
+
+    glGenBuffers(2, keyBuffers);
+    glGenBuffers(2, valueBuffers);
+    for (int i = 0; i < 2; ++i) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, keyBuffers[i]);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, pairSize, nullptr, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, valueBuffers[i]);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, pairSize, nullptr, GL_DYNAMIC_DRAW);
+    }
+
+    // Histogram of every tile, then the tile totals of each scan level until one tile covers a level
+    size_t entries = (1u << RADIX_BITS) * ((maxCount + TILE_SIZE - 1) / TILE_SIZE);
+    for (;;) {
+        GLuint buffer = 0;
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, GLsizeiptr(std::max<size_t>(entries, 1)) * sizeof(GLuint), nullptr, GL_DYNAMIC_DRAW);
+        scanLevels.push_back(buffer);
+        if (entries <= 1) {
+            break;
+        }
+        entries = (entries + TILE_SIZE - 1) / TILE_SIZE;
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    if (glGetError() == GL_OUT_OF_MEMORY) {
+        std::cerr << "ERROR::RADIX_SORT::OUT_OF_MEMORY" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void RadixSort::Destroy() {
+    glDeleteBuffers(2, keyBuffers);
+    glDeleteBuffers(2, valueBuffers);
+    if (!scanLevels.empty()) {
+        glDeleteBuffers(static_cast<GLsizei>(scanLevels.size()), scanLevels.data());
+    }
+    scanLevels.clear();
+    maxCount = 0;
+}
+
+bool RadixSort::RequestStage(Stage& stage, ShaderVariantCache& programs, const char* entryPoint) {
+    ShaderDefines defines;
+    defines.Set("LOCAL_SIZE_X", std::to_string(LOCAL_SIZE) + "u")
+        .Set("ITEMS_PER_THREAD", std::to_string(ITEMS_PER_THREAD) + "u")
+        .Set(entryPoint);
+    stage.program = programs.Request(std::string("RADIX_SORT::") + entryPoint, { { GL_COMPUTE_SHADER, "radix_sort_shader.glsl", defines } });
+    return stage.program != nullptr;
+}
+
+void RadixSort::ResolvePrograms() {
+    for (Stage* stage : { &histogram, &scatter, &scanBlocks, &scanAdd }) {
+        ResolveStage(*stage);
+    }
+}
+
+void RadixSort::ResolveStage(Stage& stage) {
+    // Every entry point keeps only the resources it uses active
+    const ShaderProgram& program = *stage.program;
+    stage.count = program.GetUniform<GLuint>("count");
+    stage.tileCount = program.GetUniform<GLuint>("tileCount");
+    if (program.HasUniform("shift")) {
+        stage.shift = program.GetUniform<GLuint>("shift");
+    }
+    const char* blockNames[] = { "KeysIn", "ValuesIn", "KeysOut", "ValuesOut", "ScanData", "BlockSums" };
+    BufferBlock* blocks[] = { &stage.keysIn, &stage.valuesIn, &stage.keysOut, &stage.valuesOut, &stage.scanData, &stage.blockSums };
+    for (int i = 0; i < 6; ++i) {
+        if (program.HasStorageBlock(blockNames[i])) {
+            *blocks[i] = program.GetStorageBlock(blockNames[i]);
+        }
+    }
+}
+
+void RadixSort::Dispatch(const Stage& stage, size_t tiles) const {
+    DispatchSize size;
+    if (!ComputeDispatchSize(tiles, 1, size)) { // One work group per tile, folded into 2D past the limit
+        return;
+    }
+    stage.tileCount.Set(static_cast<GLuint>(tiles));
+    stage.program->Use();
+    glDispatchCompute(size.x, size.y, size.z);
+}
+
+void RadixSort::Scan(size_t level, size_t count) {
+    size_t tiles = (count + TILE_SIZE - 1) / TILE_SIZE;
+    scanBlocks.count.Set(static_cast<GLuint>(count));
+    scanBlocks.scanData.Bind(scanLevels[level]);
+    scanBlocks.blockSums.Bind(scanLevels[level + 1]);
+    Dispatch(scanBlocks, tiles);
+    if (tiles <= 1) {
+        return; // The tile's exclusive scan is the whole scan
+    }
+
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    Scan(level + 1, tiles);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    scanAdd.count.Set(static_cast<GLuint>(count));
+    scanAdd.scanData.Bind(scanLevels[level]);
+    scanAdd.blockSums.Bind(scanLevels[level + 1]);
+    Dispatch(scanAdd, tiles);
+}
+
+void RadixSort::Sort(size_t count, int keyBits) {
+    count = std::min(count, maxCount);
+    if (count < 2 || keyBits <= 0) {
+        return;
+    }
+
+    size_t tiles = (count + TILE_SIZE - 1) / TILE_SIZE;
+    int passes = (std::min(keyBits, 32) + RADIX_BITS - 1) / RADIX_BITS;
+    histogram.count.Set(static_cast<GLuint>(count));
+    scatter.count.Set(static_cast<GLuint>(count));
+
+    int input = 0;
+    for (int pass = 0; pass < passes; ++pass) {
+        GLuint shift = static_cast<GLuint>(pass * RADIX_BITS);
+        int output = 1 - input;
+
+        histogram.shift.Set(shift);
+        histogram.keysIn.Bind(keyBuffers[input]);
+        histogram.scanData.Bind(scanLevels[0]);
+        Dispatch(histogram, tiles);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        Scan(0, tiles << RADIX_BITS);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        scatter.shift.Set(shift);
+        scatter.keysIn.Bind(keyBuffers[input]);
+        scatter.valuesIn.Bind(valueBuffers[input]);
+        scatter.keysOut.Bind(keyBuffers[output]);
+        scatter.valuesOut.Bind(valueBuffers[output]);
+        scatter.scanData.Bind(scanLevels[0]);
+        Dispatch(scatter, tiles);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        input = output;
+    }
+
+    // An odd pass count leaves the result in scratch
+    if (input != 0) {
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+        GLsizeiptr size = GLsizeiptr(count) * sizeof(GLuint);
+        glBindBuffer(GL_COPY_READ_BUFFER, keyBuffers[1]);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, keyBuffers[0]);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, size);
+        glBindBuffer(GL_COPY_READ_BUFFER, valueBuffers[1]);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, valueBuffers[0]);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, size);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+}
+
+void RadixSortReference(std::vector<uint32_t>& keys, std::vector<uint32_t>& values, int keyBits) {
+    const int bins = 1 << RadixSort::RADIX_BITS;
+    std::vector<uint32_t> keysOut(keys.size()), valuesOut(values.size());
+    for (int shift = 0; shift < std::min(keyBits, 32); shift += RadixSort::RADIX_BITS) {
+        size_t offsets[bins] = {};
+        for (uint32_t key : keys) {
+            ++offsets[(key >> shift) & (bins - 1)];
+        }
+        size_t sum = 0;
+        for (size_t& offset : offsets) {
+            size_t entries = offset;
+            offset = sum;
+            sum += entries;
+        }
+        for (size_t i = 0; i < keys.size(); ++i) {
+            size_t destination = offsets[(keys[i] >> shift) & (bins - 1)]++;
+            keysOut[destination] = keys[i];
+            valuesOut[destination] = values[i];
+        }
+        keys.swap(keysOut);
+        values.swap(valuesOut);
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <glew.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "ShaderProgram.h"
+#include "ShaderVariantCache.h"
+
+// GPU LSD radix sort of uint keys carrying uint values (radix_sort_shader.glsl), 4 bits per pass.
+// Other passes write their keys and values into KeysBuffer() / ValuesBuffer(), call Sort() and read
+// the sorted pairs back from the same buffers. The sort is stable, so keys that do not fill keyBits
+// keep their input order among equals. Each pass runs a per-tile digit histogram, a multi-level
+// exclusive scan of the histogram and a scatter ranked against it.
+class RadixSort {
+public:
+    static const GLuint LOCAL_SIZE = 256;
+    static const GLuint ITEMS_PER_THREAD = 8;
+    static const GLuint TILE_SIZE = LOCAL_SIZE * ITEMS_PER_THREAD;
+    static const int RADIX_BITS = 4;
+
+    // Allocates the key and value buffers plus scratch for up to maxCount pairs and requests the programs
+    // from the cache. Call ResolvePrograms() once the cache has finished building them.
+    bool Init(size_t maxCount, ShaderVariantCache& programs);
+    void ResolvePrograms();
+    void Destroy();
+
+    size_t MaxCount() const { return maxCount; }
+    GLuint KeysBuffer() const { return keyBuffers[0]; }
+    GLuint ValuesBuffer() const { return valueBuffers[0]; }
+
+    // Storage bindings of SortKeys and SortValues in the SORT_KEYS_PASS variant of compute_shader.glsl,
+    // the pass that fills KeysBuffer() and ValuesBuffer() for a sort of the particles
+    static std::vector<GLuint> SortKeyBindings() { return { 13, 14 }; }
+
+    // Sorts the first count pairs by the low keyBits of their keys. Issues its own barriers between passes;
+    // the caller makes its writes to the buffers visible to shader storage reads before calling.
+    void Sort(size_t count, int keyBits);
+
+private:
+    // One program per entry point of radix_sort_shader.glsl
+    struct Stage {
+        ShaderProgram* program = nullptr; // Owned by the variant cache
+        Uniform<GLuint> count;
+        Uniform<GLuint> shift;
+        Uniform<GLuint> tileCount;
+        BufferBlock keysIn, valuesIn, keysOut, valuesOut, scanData, blockSums;
+    };
+
+    bool RequestStage(Stage& stage, ShaderVariantCache& programs, const char* entryPoint);
+    void ResolveStage(Stage& stage);
+    void Dispatch(const Stage& stage, size_t tiles) const;
+
+    // Exclusive scan of the first count entries of scan level `level`, in place
+    void Scan(size_t level, size_t count);
+
+    Stage histogram, scatter, scanBlocks, scanAdd;
+    GLuint keyBuffers[2] = { 0, 0 };   // [0] holds the input and the result, [1] is scratch
+    GLuint valueBuffers[2] = { 0, 0 };
+    std::vector<GLuint> scanLevels;    // [0] the digit histogram, [n + 1] the tile totals of level n
+    size_t maxCount = 0;
+};
+
+// CPU reference: the same stable 4-bit LSD passes over the low keyBits, so it matches Sort() exactly
+void RadixSortReference(std::vector<uint32_t>& keys, std::vector<uint32_t>& values, int keyBits);
@@ -0,0 +1,190 @@
+#include "ShaderPreprocessor.h"
+#include "ShaderSourceFile.h"
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+
+ShaderDefines& ShaderDefines::Set(const std::string& name, const std::string& value) {
+    values[name] = value;
+    return *this;
+}
+
+ShaderDefines& ShaderDefines::Merge(const ShaderDefines& other) {
+    for (const auto& entry : other.values) {
+        values[entry.first] = entry.second;
+    }
+    return *this;
+}
+
+std::string ShaderDefines::Text() const {
+    std::string text;
+    for (const auto& entry : values) {
+        text += "#define " + entry.first + (entry.second.empty() ? "" : " " + entry.second) + "\n";
+    }
+    return text;
+}
+
+std::string ShaderDefines::Key() const {
+    std::string key;
+    for (const auto& entry : values) {
+        key += entry.first + "=" + entry.second + ";";
+    }
+    return key;
+}
+
+// Directory part of a path including the trailing separator, empty for a bare file name
+static std::string DirectoryOf(const std::string& path) {
+    size_t slash = path.find_last_of("/\\");
+    return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+}
+
+// The quoted file name if the line [begin, end) is an #include directive
+static bool ParseInclude(const char* begin, const char* end, std::string& fileName) {
+    const char* c = begin;
+    auto skipBlanks = [&]() {
+        while (c < end && (*c == ' ' || *c == '\t')) {
+            ++c;
+        }
+    };
+    skipBlanks();
+    if (c == end || *c != '#') {
+        return false;
+    }
+    ++c;
+    skipBlanks();
+    if (end - c < 7 || std::memcmp(c, "include", 7) != 0) {
+        return false;
+    }
+    const char* open = std::find(c + 7, end, '"');
+    const char* close = open == end ? end : std::find(open + 1, end, '"');
+    if (close == end) {
+        return false;
+    }
+    fileName.assign(open + 1, close);
+    return true;
+}
+
+// Appends the text [begin, end) of file (source string `index`) to out, recursing into its includes.
+// firstLine is the line number of begin within the file.
+static bool AppendFile(const std::string& path, size_t index, const char* begin, const char* end, int firstLine, std::vector<std::string>& files, std::string& out) {
+    int lineNumber = firstLine;
+    for (const char* line = begin; line < end; ++lineNumber) {
+        const char* lineEnd = std::find(line, end, '\n');
+        const char* next = lineEnd == end ? end : lineEnd + 1;
+        std::string fileName;
+        if (!ParseInclude(line, lineEnd, fileName)) {
+            out.append(line, lineEnd);
+            out += '\n';
+            line = next;
+            continue;
+        }
+        line = next;
+
+        std::string includePath = DirectoryOf(path) + fileName;
+        if (std::find(files.begin(), files.end(), includePath) != files.end()) {
+            out += "\n"; // Already included, keep the line count
+            continue;
+        }
+        ShaderSourceFile included;
+        if (!included.Open(includePath)) {
+            std::cerr << "ERROR::SHADER::INCLUDE_NOT_FOUND " << includePath << " (" << path << ":" << lineNumber << ")" << std::endl;
+            return false;
+        }
+
+        size_t includeIndex = files.size();
+        files.push_back(includePath);
+        out += "#line 1 " + std::to_string(includeIndex) + "\n";
+        if (!AppendFile(includePath, includeIndex, included.Data(), included.Data() + included.Size(), 1, files, out)) {
+            return false;
+        }
+        out += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(index) + "\n";
+    }
+    return true;
+}
+
+// A file with its includes spliced in: everything PreprocessShaderFile() produces but the defines
+struct ExpandedShaderFile {
+    std::string head; // Up to and including the #version line
+    std::string body; // The lines after it
+    int bodyLine = 1; // Line number of the first line of body
+    std::vector<std::string> files;
+};
+
+static bool ExpandShaderFile(const std::string& path, ExpandedShaderFile& expanded) {
+    expanded.files.assign(1, path);
+
+    ShaderSourceFile file;
+    if (!file.Open(path)) {
+        std::cerr << "ERROR::SHADER::FILE_NOT_READ " << path << std::endl;
+        return false;
+    }
+    const char* begin = file.Data();
+    const char* end = begin + file.Size();
+
+    // The defines go right after #version; a #line puts the lines after it back at their own numbers
+    static const char VERSION[] = "#version";
+    const char* version = std::search(begin, end, VERSION, VERSION + sizeof(VERSION) - 1);
+    const char* body = begin;
+    if (version != end) {
+        body = std::find(version, end, '\n');
+        body = body == end ? end : body + 1;
+    }
+    expanded.bodyLine = 1 + static_cast<int>(std::count(begin, body, '\n'));
+    expanded.head.assign(begin, body);
+    if (body == end && body != begin && body[-1] != '\n') {
+        expanded.head += '\n';
+    }
+    expanded.body.clear();
+    expanded.body.reserve(size_t(end - body) + 1024);
+    return AppendFile(path, 0, body, end, expanded.bodyLine, expanded.files, expanded.body);
+}
+
+// Files expanded ahead of time by PreloadShaderFiles(), by path
+static std::mutex preloadMutex;
+static std::unordered_map<std::string, ExpandedShaderFile> preloadedFiles;
+
+bool PreloadShaderFiles(const std::vector<std::string>& paths) {
+    bool succeeded = true;
+    for (const std::string& path : paths) {
+        ExpandedShaderFile expanded;
+        if (!ExpandShaderFile(path, expanded)) {
+            succeeded = false;
+            continue;
+        }
+        std::lock_guard<std::mutex> lock(preloadMutex);
+        preloadedFiles[path] = std::move(expanded);
+    }
+    return succeeded;
+}
+
+void ReleasePreloadedShaders() {
+    std::lock_guard<std::mutex> lock(preloadMutex);
+    preloadedFiles.clear();
+}
+
+bool PreprocessShaderFile(const std::string& path, const ShaderDefines& defines, PreprocessedShader& result) {
+    result.source.clear();
+    result.files.clear();
+
+    ExpandedShaderFile expanded;
+    bool found = false;
+    {
+        std::lock_guard<std::mutex> lock(preloadMutex);
+        auto it = preloadedFiles.find(path);
+        if (it != preloadedFiles.end()) {
+            expanded = it->second; // Copied, every variant splices its own defines into it
+            found = true;
+        }
+    }
+    if (!found && !ExpandShaderFile(path, expanded)) {
+        return false;
+    }
+
+    std::string defineText = defines.Text() + "#line " + std::to_string(expanded.bodyLine) + " 0\n";
+    result.source.reserve(expanded.head.size() + defineText.size() + expanded.body.size());
+    result.source.append(expanded.head).append(defineText).append(expanded.body);
+    result.files = std::move(expanded.files);
+    return true;
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <map>
+#include <string>
+#include <vector>
+
+// Host defines injected into a shader, each NAME or NAME value. Kept sorted so equal sets produce the
+// same text and the same Key() whatever order they were set in.
+class ShaderDefines {
+public:
+    ShaderDefines& Set(const std::string& name, const std::string& value = std::string());
+    ShaderDefines& Merge(const ShaderDefines& other);
+    bool Has(const std::string& name) const { return values.count(name) != 0; }
+
+    // One #define line per entry
+    std::string Text() const;
+    // Canonical NAME=value list, identifies the permutation
+    std::string Key() const;
+
+private:
+    std::map<std::string, std::string> values;
+};
+
+// A stage after preprocessing. files[i] is source string i in the #line directives, which is the
+// first number of every compiler message (0:12(3) is line 12 of files[0]).
+struct PreprocessedShader {
+    std::string source;
+    std::vector<std::string> files;
+};
+
+// Reads path through ShaderSourceFile, injects the defines after its #version line and splices in every
+// #include "file", resolved relative to the including file. A file is included once, later includes of
+// it are dropped.
+// Includes are expanded whatever the surrounding #if says, the compiler then skips inactive ones.
+// Returns false and prints ERROR::SHADER::... when a file cannot be read.
+bool PreprocessShaderFile(const std::string& path, const ShaderDefines& defines, PreprocessedShader& result);
+
+// Reads paths and expands their includes ahead of time, safe to call from any thread. PreprocessShaderFile()
+// then only injects the defines, so the startup can load its shaders on a worker while the context is
+// created. Returns false if a file cannot be read, the others are still preloaded.
+bool PreloadShaderFiles(const std::vector<std::string>& paths);
+// Later builds read the files again, call once the startup programs are submitted so hot reloads see edits
+void ReleasePreloadedShaders();
@@ -0,0 +1,320 @@
+#include "ShaderProgram.h"
+#include "ProgramBinaryCache.h"
+#include <iostream>
+#include <utility>
+#include <algorithm>
+
+// Stage name for error messages, in the ERROR::<STAGE>::... style used across the program
+static const char* ShaderStageName(GLenum shaderType) {
+    switch (shaderType) {
+    case GL_COMPUTE_SHADER: return "COMPUTESHADER";
+    case GL_VERTEX_SHADER: return "VERTEXSHADER";
+    case GL_FRAGMENT_SHADER: return "FRAGMENTSHADER";
+    case GL_GEOMETRY_SHADER: return "GEOMETRYSHADER";
+    default: return "SHADER";
+    }
+}
+
+GLuint SubmitShader(const std::string& source, GLenum shaderType) {
+    GLuint shader = glCreateShader(shaderType);
+    const char* src = source.c_str();
+    glShaderSource(shader, 1, &src, nullptr);
+    glCompileShader(shader);
+    return shader;
+}
+
+bool ShaderCompiled(GLuint shader, GLenum shaderType) {
+    // Check for shader compile errors
+    GLint success;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        GLint logLength = 0;
+        glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logLength);
+        std::string infoLog(std::max(logLength, 1), '\0');
+        glGetShaderInfoLog(shader, logLength, nullptr, &infoLog[0]);
+        std::cerr << "ERROR::" << ShaderStageName(shaderType) << "::COMPILATION_FAILED\n" << infoLog.c_str() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+ShaderProgram::~ShaderProgram() {
+    Destroy();
+}
+
+ShaderProgram::ShaderProgram(ShaderProgram&& other) noexcept {
+    *this = std::move(other);
+}
+
+ShaderProgram& ShaderProgram::operator=(ShaderProgram&& other) noexcept {
+    if (this != &other) {
+        Destroy();
+        program = other.program;
+        name = std::move(other.name);
+        uniforms = std::move(other.uniforms);
+        uniformBlocks = std::move(other.uniformBlocks);
+        storageBlocks = std::move(other.storageBlocks);
+        sourceFiles = std::move(other.sourceFiles);
+        pending = std::move(other.pending);
+        other.program = 0;
+    }
+    return *this;
+}
+
+ProgramBinaryCache* ShaderProgram::binaryCache = nullptr;
+
+void ShaderProgram::SetBinaryCache(ProgramBinaryCache* cache) {
+    binaryCache = cache;
+}
+
+bool ShaderProgram::parallelCompile = false;
+
+bool ShaderProgram::EnableParallelCompile() {
+    // 0xFFFFFFFF leaves the thread count to the driver
+    if (GLEW_KHR_parallel_shader_compile) {
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFFu);
+        parallelCompile = true;
+    }
+    else if (GLEW_ARB_parallel_shader_compile) {
+        glMaxShaderCompilerThreadsARB(0xFFFFFFFFu);
+        parallelCompile = true;
+    }
+    return parallelCompile;
+}
+
+void ShaderProgram::Submit(const std::string& programName, const std::vector<ShaderStageSource>& stages) {
+    Destroy();
+    name = programName;
+    pending.reset(new PendingBuild());
+    pending->stages = stages;
+
+    if (binaryCache && binaryCache->Enabled()) {
+        pending->cacheKey = binaryCache->Key(programName, stages);
+        GLenum format = 0;
+        std::vector<char> binary;
+        if (binaryCache->Load(pending->cacheKey, format, binary)) {
+            program = glCreateProgram();
+            glProgramBinary(program, format, binary.data(), static_cast<GLsizei>(binary.size()));
+            pending->fromBinary = true; // Finish() checks whether the driver accepted it
+            return;
+        }
+        binaryCache->CountMiss();
+    }
+    SubmitSources();
+}
+
+// Queues the compiles and the link of the pending stages, nothing here waits for the driver
+void ShaderProgram::SubmitSources() {
+    for (const ShaderStageSource& stage : pending->stages) {
+        pending->shaders.push_back(SubmitShader(stage.source, stage.type));
+    }
+    program = glCreateProgram();
+    for (GLuint shader : pending->shaders) {
+        glAttachShader(program, shader);
+    }
+    if (!pending->cacheKey.empty()) {
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+    glLinkProgram(program);
+}
+
+bool ShaderProgram::IsReady() const {
+    if (!pending || !parallelCompile) {
+        return true; // Without the extension there is nothing to poll, Finish() blocks
+    }
+    GLint completed = GL_TRUE;
+    glGetProgramiv(program, GL_COMPLETION_STATUS_KHR, &completed);
+    return completed == GL_TRUE;
+}
+
+bool ShaderProgram::Finish() {
+    if (!pending) {
+        return program != 0;
+    }
+
+    // Known before anything is linked, a program loaded from its binary is watched like one compiled from source
+    sourceFiles.clear();
+    for (const std::vector<std::string>& files : pending->stageFiles) {
+        for (const std::string& file : files) {
+            if (std::find(sourceFiles.begin(), sourceFiles.end(), file) == sourceFiles.end()) {
+                sourceFiles.push_back(file);
+            }
+        }
+    }
+
+    GLint success = GL_FALSE;
+    if (pending->fromBinary) {
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (success) {
+            binaryCache->CountHit();
+            pending.reset();
+            Reflect();
+            return true;
+        }
+        // A driver update or a corrupt file, compile from source and replace the entry
+        binaryCache->CountRejected();
+        glDeleteProgram(program);
+        program = 0;
+        pending->fromBinary = false;
+        SubmitSources();
+    }
+
+    // Report every stage that failed, the link cannot succeed then and its log would only repeat them
+    bool compiled = true;
+    for (size_t i = 0; i < pending->shaders.size(); ++i) {
+        compiled = ShaderCompiled(pending->shaders[i], pending->stages[i].type) && compiled;
+    }
+    if (compiled) {
+        glGetProgramiv(program, GL_LINK_STATUS, &success); // Check for linking errors
+        if (!success) {
+            GLint logLength = 0;
+            glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLength);
+            std::string infoLog(std::max(logLength, 1), '\0');
+            glGetProgramInfoLog(program, logLength, nullptr, &infoLog[0]);
+            std::cerr << "ERROR::" << name << "PROGRAM::LINKING_FAILED\n" << infoLog.c_str() << std::endl;
+        }
+    }
+
+    // The linked program keeps what it needs, the shader objects can go
+    for (GLuint shader : pending->shaders) {
+        glDetachShader(program, shader);
+        glDeleteShader(shader);
+    }
+    pending->shaders.clear();
+
+    if (!compiled || !success) {
+        // Compiler messages name files by index, N:line
+        for (size_t s = 0; s < pending->stageFiles.size(); ++s) {
+            std::cerr << "  " << ShaderStageName(pending->stages[s].type) << " sources:";
+            for (size_t i = 0; i < pending->stageFiles[s].size(); ++i) {
+                std::cerr << " " << i << "=" << pending->stageFiles[s][i];
+            }
+            std::cerr << std::endl;
+        }
+        Destroy();
+        return false;
+    }
+
+    if (!pending->cacheKey.empty()) {
+        binaryCache->Store(pending->cacheKey, program);
+    }
+    pending.reset();
+    Reflect();
+    return true;
+}
+
+bool ShaderProgram::Build(const std::string& programName, const std::vector<ShaderStageSource>& stages) {
+    Submit(programName, stages);
+    return Finish();
+}
+
+void ShaderProgram::Destroy() {
+    if (pending) {
+        for (GLuint shader : pending->shaders) {
+            glDeleteShader(shader);
+        }
+        pending.reset();
+    }
+    if (program) {
+        glDeleteProgram(program);
+        program = 0;
+    }
+    uniforms.clear();
+    uniformBlocks.clear();
+    storageBlocks.clear();
+}
+
+// Enumerates the program's interfaces once so lookups never go back to the driver
+void ShaderProgram::Reflect() {
+    std::string resourceName;
+
+    GLint uniformCount = 0;
+    glGetProgramInterfaceiv(program, GL_UNIFORM, GL_ACTIVE_RESOURCES, &uniformCount);
+    const GLenum uniformProps[] = { GL_NAME_LENGTH, GL_TYPE, GL_LOCATION, GL_BLOCK_INDEX, GL_ARRAY_SIZE };
+    for (GLint i = 0; i < uniformCount; ++i) {
+        GLint values[5];
+        glGetProgramResourceiv(program, GL_UNIFORM, i, 5, uniformProps, 5, nullptr, values);
+        if (values[3] != -1) {
+            continue; // Member of a uniform block, set through the block's buffer instead
+        }
+        resourceName.resize(values[0]);
+        glGetProgramResourceName(program, GL_UNIFORM, i, values[0], nullptr, &resourceName[0]);
+        resourceName.resize(values[0] > 0 ? values[0] - 1 : 0); // Drop the null terminator
+        if (resourceName.size() > 3 && resourceName.compare(resourceName.size() - 3, 3, "[0]") == 0) {
+            resourceName.resize(resourceName.size() - 3); // Arrays are reported as name[0]
+        }
+        uniforms[resourceName] = UniformInfo{ values[2], static_cast<GLenum>(values[1]), values[4] };
+    }
+
+    const GLenum blockProps[] = { GL_NAME_LENGTH, GL_BUFFER_BINDING, GL_BUFFER_DATA_SIZE };
+    const GLenum blockInterfaces[] = { GL_UNIFORM_BLOCK, GL_SHADER_STORAGE_BLOCK };
+    for (GLenum blockInterface : blockInterfaces) {
+        std::unordered_map<std::string, BlockInfo>& blocks = blockInterface == GL_UNIFORM_BLOCK ? uniformBlocks : storageBlocks;
+        GLint blockCount = 0;
+        glGetProgramInterfaceiv(program, blockInterface, GL_ACTIVE_RESOURCES, &blockCount);
+        for (GLint i = 0; i < blockCount; ++i) {
+            GLint values[3];
+            glGetProgramResourceiv(program, blockInterface, i, 3, blockProps, 3, nullptr, values);
+            resourceName.resize(values[0]);
+            glGetProgramResourceName(program, blockInterface, i, values[0], nullptr, &resourceName[0]);
+            resourceName.resize(values[0] > 0 ? values[0] - 1 : 0);
+            blocks[resourceName] = BlockInfo{ values[1], values[2] };
+        }
+    }
+}
+
+const ShaderProgram::UniformInfo* ShaderProgram::FindUniform(const std::string& uniformName, GLenum expectedType) const {
+    auto it = uniforms.find(uniformName);
+    if (it == uniforms.end()) {
+        std::cerr << name << " program: " << uniformName << " uniform location not found." << std::endl;
+        return nullptr;
+    }
+    if (it->second.type != expectedType) {
+        std::cerr << "ERROR::" << name << "PROGRAM::UNIFORM_TYPE_MISMATCH " << uniformName << std::endl;
+        return nullptr;
+    }
+    return &it->second;
+}
+
+BufferBlock ShaderProgram::FindBlock(const std::unordered_map<std::string, BlockInfo>& blocks, GLenum target, const std::string& blockName, const char* kind) const {
+    BufferBlock handle;
+    handle.target = target;
+    auto it = blocks.find(blockName);
+    if (it == blocks.end()) {
+        std::cerr << name << " program: " << blockName << " " << kind << " block not found." << std::endl;
+        return handle;
+    }
+    handle.binding = it->second.binding;
+    handle.dataSize = it->second.dataSize;
+    return handle;
+}
+
+bool ShaderProgram::SubmitFromFiles(const std::string& programName, const std::vector<ShaderFileStage>& stages) {
+    std::vector<ShaderStageSource> sources;
+    std::vector<std::vector<std::string>> stageFiles;
+    for (const ShaderFileStage& stage : stages) {
+        PreprocessedShader preprocessed;
+        if (!PreprocessShaderFile(stage.path, stage.defines, preprocessed)) {
+            std::cerr << "ERROR::" << programName << "PROGRAM::PREPROCESSING_FAILED" << std::endl;
+            Destroy();
+            return false;
+        }
+        sources.push_back({ stage.type, std::move(preprocessed.source) });
+        stageFiles.push_back(std::move(preprocessed.files));
+    }
+    Submit(programName, sources);
+    pending->stageFiles = std::move(stageFiles);
+    return true;
+}
+
+bool ShaderProgram::BuildFromFiles(const std::string& programName, const std::vector<ShaderFileStage>& stages) {
+    return SubmitFromFiles(programName, stages) && Finish();
+}
+
+BufferBlock ShaderProgram::GetStorageBlock(const std::string& blockName) const {
+    return FindBlock(storageBlocks, GL_SHADER_STORAGE_BUFFER, blockName, "storage");
+}
+
+BufferBlock ShaderProgram::GetUniformBlock(const std::string& blockName) const {
+    return FindBlock(uniformBlocks, GL_UNIFORM_BUFFER, blockName, "uniform");
+}
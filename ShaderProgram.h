@@ -0,0 +1,183 @@
+#pragma once
+#include <glew.h>
+#include <glm.hpp>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include "ShaderPreprocessor.h"
+
+class ProgramBinaryCache;
+
+// Creates and compiles one shader stage without waiting for the result
+GLuint SubmitShader(const std::string& source, GLenum shaderType);
+// Waits for the compile, prints the info log and returns false if it failed
+bool ShaderCompiled(GLuint shader, GLenum shaderType);
+
+// GL type enum matching a host type, used to check uniform handles against the reflected type
+template <typename T> struct UniformType;
+template <> struct UniformType<float> { static const GLenum value = GL_FLOAT; };
+template <> struct UniformType<glm::vec2> { static const GLenum value = GL_FLOAT_VEC2; };
+template <> struct UniformType<glm::vec3> { static const GLenum value = GL_FLOAT_VEC3; };
+template <> struct UniformType<glm::vec4> { static const GLenum value = GL_FLOAT_VEC4; };
+template <> struct UniformType<GLint> { static const GLenum value = GL_INT; };
+template <> struct UniformType<GLuint> { static const GLenum value = GL_UNSIGNED_INT; };
+template <> struct UniformType<glm::mat4> { static const GLenum value = GL_FLOAT_MAT4; };
+
+inline void SetProgramUniform(GLuint program, GLint location, float value) { glProgramUniform1f(program, location, value); }
+inline void SetProgramUniform(GLuint program, GLint location, const glm::vec2& value) { glProgramUniform2f(program, location, value.x, value.y); }
+inline void SetProgramUniform(GLuint program, GLint location, const glm::vec3& value) { glProgramUniform3f(program, location, value.x, value.y, value.z); }
+inline void SetProgramUniform(GLuint program, GLint location, const glm::vec4& value) { glProgramUniform4f(program, location, value.x, value.y, value.z, value.w); }
+inline void SetProgramUniform(GLuint program, GLint location, GLint value) { glProgramUniform1i(program, location, value); }
+inline void SetProgramUniform(GLuint program, GLint location, GLuint value) { glProgramUniform1ui(program, location, value); }
+inline void SetProgramUniform(GLuint program, GLint location, const glm::mat4& value) { glProgramUniformMatrix4fv(program, location, 1, GL_FALSE, &value[0][0]); }
+
+// Pre-resolved uniform of a known type, setting it does no string lookup.
+// A handle for a uniform the program does not have is valid to use and does nothing.
+template <typename T>
+class Uniform {
+public:
+    bool Valid() const { return location != -1; }
+    void Set(const T& value) const {
+        if (location != -1) {
+            SetProgramUniform(program, location, value);
+        }
+    }
+
+private:
+    friend class ShaderProgram;
+    GLuint program = 0;
+    GLint location = -1;
+};
+
+// Pre-resolved uniform or shader storage block and the binding point the shader declared for it
+class BufferBlock {
+public:
+    bool Valid() const { return binding != -1; }
+    GLint Binding() const { return binding; }
+    GLint64 DataSize() const { return dataSize; }
+
+    void Bind(GLuint buffer) const {
+        if (binding != -1) {
+            glBindBufferBase(target, binding, buffer);
+        }
+    }
+    void BindRange(GLuint buffer, GLintptr offset, GLsizeiptr size) const {
+        if (binding != -1) {
+            glBindBufferRange(target, binding, buffer, offset, size);
+        }
+    }
+
+private:
+    friend class ShaderProgram;
+    GLenum target = GL_SHADER_STORAGE_BUFFER;
+    GLint binding = -1;
+    GLint64 dataSize = 0; // Minimum buffer size, a runtime sized array counts as one element
+};
+
+struct ShaderStageSource {
+    GLenum type;        // GL_COMPUTE_SHADER, GL_VERTEX_SHADER, ...
+    std::string source; // GLSL source, already preprocessed
+};
+
+// A stage read from disk and run through PreprocessShaderFile
+struct ShaderFileStage {
+    GLenum type;
+    std::string path;
+    ShaderDefines defines;
+};
+
+// Linked program plus everything reflected from it at link time:
+// active uniforms, uniform blocks and shader storage blocks.
+class ShaderProgram {
+public:
+    ShaderProgram() = default;
+    ~ShaderProgram();
+    ShaderProgram(const ShaderProgram&) = delete;
+    ShaderProgram& operator=(const ShaderProgram&) = delete;
+    ShaderProgram(ShaderProgram&& other) noexcept;
+    ShaderProgram& operator=(ShaderProgram&& other) noexcept;
+
+    // Cache every Build() goes through, null to always compile. Set once at startup, before any build.
+    static void SetBinaryCache(ProgramBinaryCache* cache);
+
+    // Lets the driver compile and link on its own threads where KHR_parallel_shader_compile (or the ARB
+    // version) is available, returns whether it is. Call once at startup.
+    static bool EnableParallelCompile();
+
+    // Compiles and links the stages; name is used in error messages (COMPUTE, RENDER, ...).
+    // With a binary cache, a cached binary of the same sources is loaded instead when the driver accepts it.
+    bool Build(const std::string& name, const std::vector<ShaderStageSource>& stages);
+    bool BuildFromFiles(const std::string& name, const std::vector<ShaderFileStage>& stages);
+
+    // Build() in two halves. Submit queues the compiles and the link without asking for their result, so
+    // with parallel compile the driver works on every submitted program at once while the caller does
+    // other work. Finish waits for the result, reports errors and reflects the program.
+    void Submit(const std::string& name, const std::vector<ShaderStageSource>& stages);
+    bool SubmitFromFiles(const std::string& name, const std::vector<ShaderFileStage>& stages); // false if a file cannot be read
+    bool Finish();
+    // Whether Finish() would return without waiting; always true without parallel compile
+    bool IsReady() const;
+    bool IsBuilding() const { return pending != nullptr; }
+
+    void Destroy();
+
+    // Every file BuildFromFiles read, the stages' own files first and then what they included
+    const std::vector<std::string>& SourceFiles() const { return sourceFiles; }
+
+    GLuint Id() const { return program; }
+    void Use() const { glUseProgram(program); }
+
+    // Handle lookups are meant for setup time, the handles are then used every frame
+    template <typename T>
+    Uniform<T> GetUniform(const std::string& uniformName) const {
+        Uniform<T> handle;
+        const UniformInfo* info = FindUniform(uniformName, UniformType<T>::value);
+        if (info) {
+            handle.program = program;
+            handle.location = info->location;
+        }
+        return handle;
+    }
+    // For uniforms and blocks that only some variants of a shader keep active, check without reporting an error
+    bool HasUniform(const std::string& uniformName) const { return uniforms.count(uniformName) != 0; }
+    bool HasStorageBlock(const std::string& blockName) const { return storageBlocks.count(blockName) != 0; }
+    BufferBlock GetStorageBlock(const std::string& blockName) const;
+    BufferBlock GetUniformBlock(const std::string& blockName) const;
+
+private:
+    struct UniformInfo {
+        GLint location;
+        GLenum type;
+        GLint arraySize;
+    };
+    struct BlockInfo {
+        GLint binding;
+        GLint64 dataSize;
+    };
+
+    // Everything Finish() needs from Submit()
+    struct PendingBuild {
+        std::vector<ShaderStageSource> stages;            // Kept to compile from source if the cached binary is rejected
+        std::vector<GLuint> shaders;
+        std::string cacheKey;
+        bool fromBinary = false;
+        std::vector<std::vector<std::string>> stageFiles; // Per stage, the file index of compiler messages
+    };
+
+    void SubmitSources();
+    void Reflect();
+    const UniformInfo* FindUniform(const std::string& uniformName, GLenum expectedType) const;
+    BufferBlock FindBlock(const std::unordered_map<std::string, BlockInfo>& blocks, GLenum target, const std::string& blockName, const char* kind) const;
+
+    static ProgramBinaryCache* binaryCache;
+    static bool parallelCompile;
+
+    GLuint program = 0;
+    std::string name;
+    std::unordered_map<std::string, UniformInfo> uniforms;
+    std::unordered_map<std::string, BlockInfo> uniformBlocks;
+    std::unordered_map<std::string, BlockInfo> storageBlocks;
+    std::vector<std::string> sourceFiles;
+    std::unique_ptr<PendingBuild> pending;
+};
@@ -0,0 +1,131 @@
+#include "ShaderReloader.h"
+#include "CpuProfiler.h"
+#include <iostream>
+#include <algorithm>
+
+static const int WATCH_TIMEOUT_MS = 100; // How often the worker checks whether it should stop
+
+ShaderReloader::~ShaderReloader() {
+    Stop();
+}
+
+void ShaderReloader::Watch(ShaderProgram& program, const std::string& name, const std::vector<ShaderFileStage>& stages, std::function<void()> onSwap) {
+    for (Entry& entry : entries) {
+        if (entry.program == &program) {
+            entry.onSwap.push_back(onSwap);
+            return;
+        }
+    }
+    entries.push_back({ &program, name, stages, program.SourceFiles(), { onSwap } });
+}
+
+bool ShaderReloader::WatchFiles() {
+    std::vector<std::string> paths;
+    for (const Entry& entry : entries) {
+        for (const std::string& file : entry.files) {
+            if (std::find(paths.begin(), paths.end(), file) == paths.end()) {
+                paths.push_back(file);
+            }
+        }
+    }
+    return watcher.Init(paths);
+}
+
+bool ShaderReloader::Start(GLFWwindow* mainWindow) {
+    if (!WatchFiles()) {
+        return false;
+    }
+
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    workerContext = glfwCreateWindow(1, 1, "Shader reload", NULL, mainWindow);
+    if (!workerContext) {
+        std::cerr << "ERROR::SHADER_RELOAD::CONTEXT_CREATION_FAILED" << std::endl;
+        return false;
+    }
+
+    stopping = false;
+    worker = std::thread(&ShaderReloader::Run, this);
+    return true;
+}
+
+void ShaderReloader::Stop() {
+    if (worker.joinable()) {
+        stopping = true;
+        worker.join();
+    }
+    if (workerContext) {
+        glfwDestroyWindow(workerContext);
+        workerContext = nullptr;
+    }
+    for (Result& result : results) {
+        glDeleteSync(result.fence);
+    }
+    results.clear();
+    watcher.Destroy();
+}
+
+void ShaderReloader::Run() {
+    CpuProfiler::SetThreadName("shader reload");
+    glfwMakeContextCurrent(workerContext);
+    while (!stopping) {
+        std::vector<std::string> changed = watcher.Wait(WATCH_TIMEOUT_MS);
+        bool filesChanged = false;
+        for (size_t i = 0; i < entries.size() && !changed.empty(); ++i) {
+            Entry& entry = entries[i];
+            bool affected = std::any_of(entry.files.begin(), entry.files.end(), [&](const std::string& file) {
+                return std::find(changed.begin(), changed.end(), file) != changed.end();
+            });
+            if (!affected) {
+                continue;
+            }
+
+            CpuZone zone("shader rebuild");
+            ShaderProgram program;
+            if (!program.BuildFromFiles(entry.name, entry.stages)) {
+                std::cerr << entry.name << " program: reload failed, keeping the running program" << std::endl;
+                continue;
+            }
+            GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            glFlush(); // The main context can only see the fence signal once it has been submitted
+            if (program.SourceFiles() != entry.files) {
+                entry.files = program.SourceFiles(); // An #include was added or removed
+                filesChanged = true;
+            }
+
+            std::lock_guard<std::mutex> lock(resultMutex);
+            results.push_back({ i, std::move(program), fence });
+        }
+        if (filesChanged && !WatchFiles()) {
+            std::cerr << "ERROR::SHADER_RELOAD::WATCH_FAILED" << std::endl;
+        }
+    }
+    glfwMakeContextCurrent(nullptr);
+}
+
+void ShaderReloader::Poll() {
+    // Never wait for the worker, a result it is adding now is picked up next frame
+    std::unique_lock<std::mutex> lock(resultMutex, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        return;
+    }
+    for (size_t r = 0; r < results.size(); ) {
+        Result& result = results[r];
+        GLenum status = glClientWaitSync(result.fence, 0, 0); // Zero timeout: only check the fence
+        if (status == GL_TIMEOUT_EXPIRED) {
+            ++r;
+            continue;
+        }
+        glDeleteSync(result.fence);
+
+        // A newer build of the same program may already be queued behind this one, it wins when it lands
+        const Entry& entry = entries[result.entry];
+        if (status != GL_WAIT_FAILED) {
+            *entry.program = std::move(result.program);
+            for (const std::function<void()>& onSwap : entry.onSwap) {
+                onSwap();
+            }
+            std::cout << entry.name << " program: reloaded" << std::endl;
+        }
+        results.erase(results.begin() + r);
+    }
+}
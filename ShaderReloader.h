@@ -0,0 +1,59 @@
+#pragma once
+#include <glew.h>
+#include <glfw3.h>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "FileWatcher.h"
+#include "ShaderProgram.h"
+
+// Rebuilds programs whose shader files change on disk, without stalling the render loop.
+// A worker thread owns a hidden context sharing objects with the main one; it waits on a FileWatcher,
+// compiles and links the changed programs there and fences each result. Poll(), called once per frame
+// on the main thread, swaps in the programs whose fence has signaled. A program that fails to compile
+// or link is reported and never swapped in, the running one stays.
+class ShaderReloader {
+public:
+    ~ShaderReloader();
+
+    // Register before Start(). onSwap runs on the main thread right after program was replaced,
+    // it re-resolves the handles the loop uses and re-sets uniforms that are only set once.
+    // Watching a program again, as passes sharing a variant do, only adds its onSwap.
+    void Watch(ShaderProgram& program, const std::string& name, const std::vector<ShaderFileStage>& stages, std::function<void()> onSwap);
+
+    // Creates the worker context (on the main thread, as GLFW requires) and starts the worker
+    bool Start(GLFWwindow* mainWindow);
+    void Stop();
+
+    void Poll();
+
+private:
+    struct Entry {
+        ShaderProgram* program;
+        std::string name;
+        std::vector<ShaderFileStage> stages;
+        std::vector<std::string> files; // Stage files and their includes as of the last build, worker-owned once started
+        std::vector<std::function<void()>> onSwap;
+    };
+    struct Result {
+        size_t entry;
+        ShaderProgram program;
+        GLsync fence; // Signaled once the worker's compile and link have finished on the GPU side
+    };
+
+    void Run();
+    // Points the watcher at every entry's files
+    bool WatchFiles();
+
+    std::vector<Entry> entries;
+    FileWatcher watcher;
+    GLFWwindow* workerContext = nullptr;
+    std::thread worker;
+    std::atomic<bool> stopping{ false };
+
+    std::mutex resultMutex;
+    std::vector<Result> results; // Built by the worker, not yet swapped in
+};
@@ -0,0 +1,109 @@
+#include "ShaderSourceFile.h"
+#include "EmbeddedShaders.h"
+#include <cstring>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef SHADERLOADER_EMBED_SHADERS
+static ShaderSourceMode sourceMode = ShaderSourceMode::Embedded;
+#else
+static ShaderSourceMode sourceMode = ShaderSourceMode::Disk;
+#endif
+
+void SetShaderSourceMode(ShaderSourceMode mode) {
+    sourceMode = mode == ShaderSourceMode::Embedded && !HasEmbeddedShaders() ? ShaderSourceMode::Disk : mode;
+}
+
+ShaderSourceMode GetShaderSourceMode() {
+    return sourceMode;
+}
+
+bool HasEmbeddedShaders() {
+    size_t count = 0;
+    EmbeddedShaders(count);
+    return count > 0;
+}
+
+ShaderSourceFile::~ShaderSourceFile() {
+    Close();
+}
+
+bool ShaderSourceFile::Open(const std::string& path) {
+    Close();
+    if (sourceMode == ShaderSourceMode::Embedded) {
+        size_t count = 0;
+        const EmbeddedShader* shaders = EmbeddedShaders(count);
+        for (size_t i = 0; i < count; ++i) {
+            if (path == shaders[i].path) {
+                data = shaders[i].source;
+                size = shaders[i].size;
+                return true;
+            }
+        }
+        return false;
+    }
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize)) {
+        CloseHandle(file);
+        return false;
+    }
+    size = static_cast<size_t>(fileSize.QuadPart);
+    if (size > 0) {
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        mappedView = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        if (mapping) {
+            CloseHandle(mapping); // The view keeps the mapping alive
+        }
+    }
+    CloseHandle(file);
+#else
+    int file = open(path.c_str(), O_RDONLY);
+    if (file < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(file, &info) != 0) {
+        close(file);
+        return false;
+    }
+    size = static_cast<size_t>(info.st_size);
+    if (size > 0) {
+        void* view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+        mappedView = view == MAP_FAILED ? nullptr : view;
+    }
+    close(file); // The mapping stays valid without the descriptor
+#endif
+    if (size > 0 && !mappedView) {
+        size = 0;
+        return false;
+    }
+    data = size > 0 ? static_cast<const char*>(mappedView) : "";
+    return true;
+}
+
+void ShaderSourceFile::Close() {
+    if (mappedView) {
+#ifdef _WIN32
+        UnmapViewOfFile(mappedView);
+#else
+        munmap(mappedView, size);
+#endif
+        mappedView = nullptr;
+    }
+    data = nullptr;
+    size = 0;
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+// Where shader sources are read from
+enum class ShaderSourceMode {
+    Embedded, // The copies compiled into the executable at build time, nothing is read from disk
+    Disk,     // The .glsl files next to the working directory, memory mapped
+};
+
+// Embedded in builds made with SHADERLOADER_EMBED_SHADERS, Disk otherwise. Set once at startup,
+// before any program is built; Embedded falls back to Disk when nothing was embedded.
+void SetShaderSourceMode(ShaderSourceMode mode);
+ShaderSourceMode GetShaderSourceMode();
+bool HasEmbeddedShaders();
+
+// Read-only view of one shader source. Embedded sources point straight into the executable's data and
+// files on disk are mapped, so neither is copied before the preprocessor splices it into the program.
+class ShaderSourceFile {
+public:
+    ShaderSourceFile() = default;
+    ~ShaderSourceFile();
+    ShaderSourceFile(const ShaderSourceFile&) = delete;
+    ShaderSourceFile& operator=(const ShaderSourceFile&) = delete;
+
+    // Looks path up where the current mode says, false if there is no such shader
+    bool Open(const std::string& path);
+    void Close();
+
+    const char* Data() const { return data; }
+    size_t Size() const { return size; }
+
+private:
+    const char* data = nullptr;
+    size_t size = 0;
+    void* mappedView = nullptr; // Set for mapped files, unmapped by Close()
+};
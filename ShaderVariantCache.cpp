@@ -0,0 +1,64 @@
+#include "ShaderVariantCache.h"
+
+std::string ShaderVariantCache::Key(const std::vector<ShaderFileStage>& stages) {
+    std::string key;
+    for (const ShaderFileStage& stage : stages) {
+        key += std::to_string(stage.type) + ":" + stage.path + "{" + stage.defines.Key() + "}";
+    }
+    return key;
+}
+
+ShaderProgram* ShaderVariantCache::Request(const std::string& name, const std::vector<ShaderFileStage>& stages) {
+    std::string key = Key(stages);
+    auto it = programs.find(key);
+    if (it != programs.end()) {
+        ++hits;
+        return it->second.get();
+    }
+
+    std::unique_ptr<ShaderProgram> program(new ShaderProgram());
+    if (!program->SubmitFromFiles(name, stages)) {
+        return nullptr; // Not cached, asking again retries the build
+    }
+    ShaderProgram* result = program.get();
+    programs.emplace(key, std::move(program));
+    return result;
+}
+
+ShaderProgram* ShaderVariantCache::Get(const std::string& name, const std::vector<ShaderFileStage>& stages) {
+    ShaderProgram* program = Request(name, stages);
+    if (program && !program->Finish()) {
+        programs.erase(Key(stages));
+        return nullptr;
+    }
+    return program;
+}
+
+bool ShaderVariantCache::Finish() {
+    bool succeeded = true;
+    for (auto it = programs.begin(); it != programs.end(); ) {
+        if (it->second->IsBuilding() && !it->second->Finish()) {
+            it = programs.erase(it);
+            succeeded = false;
+        }
+        else {
+            ++it;
+        }
+    }
+    return succeeded;
+}
+
+size_t ShaderVariantCache::Pending() const {
+    size_t count = 0;
+    for (const auto& entry : programs) {
+        if (entry.second->IsBuilding() && !entry.second->IsReady()) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+void ShaderVariantCache::Clear() {
+    programs.clear();
+    hits = 0;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ShaderProgram.h"
+
+// Owns one program per permutation: the same stage files with the same define set are compiled once,
+// however many passes ask for them. Programs live until Clear(), the returned pointers stay valid.
+class ShaderVariantCache {
+public:
+    // The program for stages, built on first use; null if it does not compile. name is only used in
+    // messages of the first build, requests for an existing permutation under another name share it.
+    ShaderProgram* Get(const std::string& name, const std::vector<ShaderFileStage>& stages);
+
+    // Get() without waiting: a new permutation is only submitted, the program is usable once Finish()
+    // returned true. Null if a file cannot be read.
+    ShaderProgram* Request(const std::string& name, const std::vector<ShaderFileStage>& stages);
+    // Waits for every submitted build. Programs that failed are dropped, pointers to them become invalid.
+    bool Finish();
+    // Submitted builds the driver is still working on, checked without waiting
+    size_t Pending() const;
+
+    void Clear();
+
+    // Identifies a permutation: stage types, files and define sets
+    static std::string Key(const std::vector<ShaderFileStage>& stages);
+
+    size_t Size() const { return programs.size(); }
+    int Hits() const { return hits; }
+
+private:
+    std::unordered_map<std::string, std::unique_ptr<ShaderProgram>> programs;
+    int hits = 0;
+};
@@ -0,0 +1,111 @@
+#include "SortBenchmark.h"
+#include "RadixSort.h"
+#include "ParticleRandom.h"
+#include <glew.h>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <vector>
+
+typedef std::chrono::high_resolution_clock Clock;
+
+static double Milliseconds(Clock::time_point start, Clock::time_point end) {
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+static void Upload(const RadixSort& sorter, const std::vector<uint32_t>& keys, const std::vector<uint32_t>& values) {
+    GLsizeiptr size = GLsizeiptr(keys.size()) * sizeof(uint32_t);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, sorter.KeysBuffer());
+    glBufferSubData(GL_COPY_WRITE_BUFFER, 0, size, keys.data());
+    glBindBuffer(GL_COPY_WRITE_BUFFER, sorter.ValuesBuffer());
+    glBufferSubData(GL_COPY_WRITE_BUFFER, 0, size, values.data());
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+static void Download(GLuint buffer, std::vector<uint32_t>& data) {
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+    glGetBufferSubData(GL_COPY_READ_BUFFER, 0, GLsizeiptr(data.size()) * sizeof(uint32_t), data.data());
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+}
+
+bool RunSortBenchmark(size_t count, int iterations, uint32_t seed, std::ostream& out) {
+    ShaderVariantCache programs;
+    RadixSort sorter;
+    if (!sorter.Init(count, programs) || !programs.Finish()) {
+        sorter.Destroy();
+        return false;
+    }
+    sorter.ResolvePrograms();
+    iterations = std::max(iterations, 1);
+
+    out << "=== Sort benchmark ===\n"
+        << "renderer: " << reinterpret_cast<const char*>(glGetString(GL_RENDERER)) << "\n"
+        << "keys: " << count << "\n"
+        << "iterations: " << iterations << "\n";
+
+    bool passed = true;
+    for (int keyBits : { 16, 32 }) {
+        // Keys from the particle RNG so a seed reproduces the input, values are the input positions
+        std::vector<uint32_t> keys(count), values(count);
+        const uint32_t keyMask = keyBits >= 32 ? 0xFFFFFFFFu : (1u << keyBits) - 1u;
+        for (size_t i = 0; i < count; ++i) {
+            keys[i] = ParticleRandom(seed, static_cast<uint32_t>(i), 0).x & keyMask;
+        }
+        std::iota(values.begin(), values.end(), 0u);
+
+        // Reference and std::stable_sort on the CPU
+        std::vector<uint32_t> referenceKeys = keys, referenceValues = values;
+        Clock::time_point start = Clock::now();
+        RadixSortReference(referenceKeys, referenceValues, keyBits);
+        double referenceMs = Milliseconds(start, Clock::now());
+
+        std::vector<uint32_t> order = values;
+        start = Clock::now();
+        std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return keys[a] < keys[b]; });
+        double stableSortMs = Milliseconds(start, Clock::now());
+
+        // GPU, one untimed sort to warm up, then the measured ones; the upload is outside the timing
+        std::vector<double> gpuMs;
+        for (int i = 0; i <= iterations; ++i) {
+            Upload(sorter, keys, values);
+            glFinish();
+            start = Clock::now();
+            sorter.Sort(count, keyBits);
+            glFinish();
+            if (i > 0) {
+                gpuMs.push_back(Milliseconds(start, Clock::now()));
+            }
+        }
+        std::sort(gpuMs.begin(), gpuMs.end());
+        double medianMs = gpuMs[gpuMs.size() / 2];
+
+        std::vector<uint32_t> sortedKeys(count), sortedValues(count);
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+        Download(sorter.KeysBuffer(), sortedKeys);
+        Download(sorter.ValuesBuffer(), sortedValues);
+        bool matches = true;
+        for (size_t i = 0; i < count; ++i) {
+            if (sortedKeys[i] != referenceKeys[i] || sortedValues[i] != referenceValues[i]) {
+                std::cerr << "ERROR::RADIX_SORT::MISMATCH " << keyBits << "-bit keys at " << i << ": got (" << sortedKeys[i] << ", " << sortedValues[i]
+                    << "), expected (" << referenceKeys[i] << ", " << referenceValues[i] << ")" << std::endl;
+                matches = false;
+                break;
+            }
+        }
+
+        std::string prefix = "bits" + std::to_string(keyBits) + "_";
+        out << prefix << "gpu_ms_p50: " << medianMs << "\n"
+            << prefix << "gpu_ms_min: " << gpuMs.front() << "\n"
+            << prefix << "gpu_mkeys_per_sec: " << (medianMs > 0.0 ? count / (medianMs * 1000.0) : 0.0) << "\n"
+            << prefix << "cpu_reference_ms: " << referenceMs << "\n"
+            << prefix << "cpu_stable_sort_ms: " << stableSortMs << "\n"
+            << prefix << "result: " << (matches ? "passed" : "FAILED") << "\n";
+        passed = passed && matches;
+    }
+    out.flush();
+
+    sorter.Destroy();
+    return passed;
+}
@@ -0,0 +1,9 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+// Microbenchmark of RadixSort on random keys, 16-bit (the draw order key) and full 32-bit.
+// Every GPU result is checked against RadixSortReference; std::stable_sort is timed alongside for scale.
+// Returns false on a mismatch or when the sort cannot be set up.
+bool RunSortBenchmark(size_t count, int iterations, uint32_t seed, std::ostream& out);
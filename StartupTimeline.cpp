@@ -0,0 +1,44 @@
+#include "StartupTimeline.h"
+#include <algorithm>
+#include <iomanip>
+#include <string>
+
+StartupTimeline::StartupTimeline(int64_t startupOrigin) : origin(startupOrigin) {
+    threads.push_back(std::this_thread::get_id());
+}
+
+void StartupTimeline::Record(const char* name, int64_t begin, int64_t end) {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::thread::id id = std::this_thread::get_id();
+    auto known = std::find(threads.begin(), threads.end(), id);
+    int thread = static_cast<int>(known - threads.begin());
+    if (known == threads.end()) {
+        threads.push_back(id);
+    }
+    phases.push_back({ name, thread, begin, end });
+}
+
+void StartupTimeline::Print(std::ostream& out, int64_t firstFrame) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<Phase> ordered = phases;
+    std::stable_sort(ordered.begin(), ordered.end(), [](const Phase& a, const Phase& b) { return a.begin < b.begin; });
+
+    const std::ios::fmtflags flags = out.flags();
+    const std::streamsize precision = out.precision();
+    const int BAR_WIDTH = 40;
+    const double total = double(std::max<int64_t>(firstFrame - origin, 1));
+    auto milliseconds = [this](int64_t time) { return double(time - origin) * 1e-6; };
+    out << "Startup timeline, first frame " << std::fixed << std::setprecision(1) << milliseconds(firstFrame) << " ms after start:\n";
+    for (const Phase& phase : ordered) {
+        int first = std::min(BAR_WIDTH - 1, int(double(phase.begin - origin) / total * BAR_WIDTH));
+        int last = std::max(first, std::min(BAR_WIDTH - 1, int(double(phase.end - origin) / total * BAR_WIDTH)));
+        std::string bar(BAR_WIDTH, ' ');
+        std::fill(bar.begin() + first, bar.begin() + last + 1, '#');
+        std::string thread = phase.thread == 0 ? "main" : "worker " + std::to_string(phase.thread);
+        out << "  [" << bar << "] " << std::setw(8) << milliseconds(phase.begin) << " - " << std::setw(8) << milliseconds(phase.end) << " ms  "
+            << std::left << std::setw(10) << thread << std::right << phase.name << "\n";
+    }
+    out.flags(flags);
+    out.precision(precision);
+    out << std::flush;
+}
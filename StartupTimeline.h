@@ -0,0 +1,52 @@
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+#include "CpuProfiler.h"
+
+// Phases of the startup on every thread, printed once the first frame is out so overlapping work and
+// the time to first frame can be read at a glance. Recording takes a lock, it only happens a few dozen
+// times per run. The phases are also CPU profiler zones, a capture from frame 0 shows them in the trace.
+class StartupTimeline {
+public:
+    // origin is when startup began, on CpuProfiler::Now()'s clock; the constructing thread is the main one
+    explicit StartupTimeline(int64_t origin);
+
+    // name is kept as a pointer, like a CpuZone's
+    void Record(const char* name, int64_t begin, int64_t end);
+
+    // One line per phase ordered by start, each with a bar on a common time axis ending at firstFrame
+    void Print(std::ostream& out, int64_t firstFrame) const;
+
+private:
+    struct Phase {
+        const char* name;
+        int thread; // 0 is the main thread, workers are numbered as they first record
+        int64_t begin;
+        int64_t end;
+    };
+
+    int64_t origin;
+    std::vector<Phase> phases;
+    std::vector<std::thread::id> threads;
+    mutable std::mutex mutex;
+};
+
+// Records its lifetime as a phase of the timeline and as a zone of the CPU profiler
+class StartupPhase {
+public:
+    StartupPhase(StartupTimeline& startupTimeline, const char* phaseName)
+        : timeline(startupTimeline), name(phaseName), zone(phaseName), begin(CpuProfiler::Now()) {}
+    ~StartupPhase() { timeline.Record(name, begin, CpuProfiler::Now()); }
+
+    StartupPhase(const StartupPhase&) = delete;
+    StartupPhase& operator=(const StartupPhase&) = delete;
+
+private:
+    StartupTimeline& timeline;
+    const char* name;
+    CpuZone zone;
+    int64_t begin;
+};
@@ -0,0 +1,78 @@
+#include "TaskGraph.h"
+#include "CpuProfiler.h"
+#include <algorithm>
+#include <string>
+
+TaskGraph::TaskGraph(unsigned threadCount) {
+    threadCount = std::max(1u, threadCount);
+    for (unsigned i = 0; i < threadCount; ++i) {
+        workers.emplace_back(&TaskGraph::WorkerLoop, this, i + 1);
+    }
+}
+
+TaskGraph::~TaskGraph() {
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this]() {
+            return std::all_of(nodes.begin(), nodes.end(), [](const std::unique_ptr<Node>& node) { return node->finished; });
+        });
+        stopping = true;
+    }
+    changed.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+TaskGraph::Task TaskGraph::Add(std::vector<Task> dependencies, std::function<bool()> run) {
+    Task task;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        task = static_cast<Task>(nodes.size());
+        nodes.emplace_back(new Node());
+        nodes.back()->dependencies = std::move(dependencies);
+        nodes.back()->run = std::move(run);
+    }
+    changed.notify_all();
+    return task;
+}
+
+bool TaskGraph::Wait(Task task) {
+    std::unique_lock<std::mutex> lock(mutex);
+    const Node& node = *nodes[task];
+    changed.wait(lock, [&node]() { return node.finished; });
+    return node.succeeded;
+}
+
+TaskGraph::Task TaskGraph::NextRunnable() const {
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        const Node& node = *nodes[i];
+        if (!node.started && std::all_of(node.dependencies.begin(), node.dependencies.end(), [this](Task dependency) { return nodes[dependency]->finished; })) {
+            return static_cast<Task>(i);
+        }
+    }
+    return -1;
+}
+
+void TaskGraph::WorkerLoop(unsigned index) {
+    CpuProfiler::SetThreadName("task worker " + std::to_string(index));
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        Task task = -1;
+        changed.wait(lock, [&]() { return stopping || (task = NextRunnable()) != -1; });
+        if (task == -1) {
+            return; // Stopping, and the destructor made sure nothing is left to run
+        }
+
+        Node& node = *nodes[task];
+        node.started = true;
+        bool dependenciesSucceeded = std::all_of(node.dependencies.begin(), node.dependencies.end(), [this](Task dependency) { return nodes[dependency]->succeeded; });
+        lock.unlock();
+        bool succeeded = dependenciesSucceeded && node.run();
+        lock.lock();
+        node.succeeded = succeeded;
+        node.finished = true;
+        node.run = nullptr; // Releases whatever the task captured
+        changed.notify_all();
+    }
+}
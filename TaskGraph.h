@@ -0,0 +1,47 @@
+#pragma once
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Graph of one-shot tasks run by worker threads, for the startup work that needs no GL context.
+// A task runs once every task it depends on has finished; the thread owning the context carries on with
+// the GL work and only waits for a task when it is about to use its result. Tasks report success, a
+// task whose dependency failed is not run and fails as well.
+class TaskGraph {
+public:
+    typedef int Task;
+
+    explicit TaskGraph(unsigned threadCount);
+    ~TaskGraph(); // Waits for every task added
+
+    TaskGraph(const TaskGraph&) = delete;
+    TaskGraph& operator=(const TaskGraph&) = delete;
+
+    // Tasks may be added at any time, dependencies must have been added before
+    Task Add(std::vector<Task> dependencies, std::function<bool()> run);
+
+    // Blocks until task has finished, returns whether it succeeded
+    bool Wait(Task task);
+
+private:
+    struct Node {
+        std::vector<Task> dependencies;
+        std::function<bool()> run;
+        bool started = false;
+        bool finished = false;
+        bool succeeded = false;
+    };
+
+    void WorkerLoop(unsigned index);
+    // Next task whose dependencies have all finished, -1 if there is none; needs the mutex
+    Task NextRunnable() const;
+
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<Node>> nodes; // Pointers, nodes stay put while the vector grows
+    std::mutex mutex;
+    std::condition_variable changed; // A task was added or finished
+    bool stopping = false;
+};
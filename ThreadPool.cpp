@@ -0,0 +1,140 @@
+#include "ThreadPool.h"
+#include "CpuProfiler.h"
+#include <string>
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned threadCount) {
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    ranges.reset(new ChunkRange[threadCount]);
+    for (unsigned i = 1; i < threadCount; ++i) {
+        workers.emplace_back(&ThreadPool::WorkerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(jobMutex);
+        stopping = true;
+    }
+    jobStarted.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::ParallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& body) {
+    grain = std::max<size_t>(grain, 1);
+    size_t chunkCount = (count + grain - 1) / grain;
+    if (chunkCount <= 1 || workers.empty()) {
+        if (count > 0) {
+            body(0, count); // Not worth waking anyone
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(jobMutex);
+        jobBody = &body;
+        jobCount = count;
+        jobGrain = grain;
+
+        // Deal the chunks out evenly, stealing fixes whatever imbalance is left
+        unsigned threads = ThreadCount();
+        for (unsigned i = 0; i < threads; ++i) {
+            std::lock_guard<std::mutex> rangeLock(ranges[i].mutex);
+            ranges[i].begin = chunkCount * i / threads;
+            ranges[i].end = chunkCount * (i + 1) / threads;
+        }
+
+        ++generation;
+        jobOpen = true;
+    }
+    jobStarted.notify_all();
+
+    RunChunks(0);
+
+    // Every chunk has been taken once this thread runs dry, wait for the workers still running theirs.
+    // Closing the loop first keeps late wakers from joining it after it returned.
+    std::unique_lock<std::mutex> lock(jobMutex);
+    jobOpen = false;
+    jobFinished.wait(lock, [this]() { return activeWorkers == 0; });
+    jobBody = nullptr;
+}
+
+void ThreadPool::WorkerLoop(unsigned index) {
+    CpuProfiler::SetThreadName("pool worker " + std::to_string(index));
+    unsigned seenGeneration = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(jobMutex);
+            jobStarted.wait(lock, [&]() { return stopping || generation != seenGeneration; });
+            if (stopping) {
+                return;
+            }
+            seenGeneration = generation;
+            if (!jobOpen) {
+                continue; // Woke up after the loop was already done
+            }
+            ++activeWorkers;
+        }
+
+        RunChunks(index);
+
+        {
+            std::lock_guard<std::mutex> lock(jobMutex);
+            --activeWorkers;
+        }
+        jobFinished.notify_one();
+    }
+}
+
+void ThreadPool::RunChunks(unsigned index) {
+    CpuZone zone("parallel for");
+    size_t chunk;
+    for (;;) {
+        while (TakeChunk(index, chunk)) {
+            size_t begin = chunk * jobGrain;
+            (*jobBody)(begin, std::min(begin + jobGrain, jobCount));
+        }
+        if (!Steal(index)) {
+            return; // Nothing left anywhere
+        }
+    }
+}
+
+bool ThreadPool::TakeChunk(unsigned index, size_t& chunk) {
+    ChunkRange& range = ranges[index];
+    std::lock_guard<std::mutex> lock(range.mutex);
+    if (range.begin == range.end) {
+        return false;
+    }
+    chunk = range.begin++;
+    return true;
+}
+
+bool ThreadPool::Steal(unsigned thief) {
+    unsigned threads = ThreadCount();
+    for (unsigned offset = 1; offset < threads; ++offset) {
+        ChunkRange& victim = ranges[(thief + offset) % threads];
+        size_t begin, end;
+        {
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            size_t remaining = victim.end - victim.begin;
+            if (remaining == 0) {
+                continue;
+            }
+            // Take the back half, the victim keeps working on the front
+            end = victim.end;
+            begin = victim.end - (remaining + 1) / 2;
+            victim.end = begin;
+        }
+        ChunkRange& own = ranges[thief];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        own.begin = begin;
+        own.end = end;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fork-join pool for data-parallel loops with range stealing.
+// ParallelFor deals the chunks of a loop out to every thread as one contiguous range each. A thread works
+// through its own range from the front; once it runs dry it steals the back half of another thread's
+// remaining range, so uneven chunks balance out without a shared queue every thread contends on.
+// The calling thread takes part, so a pool of N threads runs N - 1 workers.
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned threadCount = 0); // 0 = one thread per hardware thread
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned ThreadCount() const { return static_cast<unsigned>(workers.size()) + 1; }
+
+    // Calls body(begin, end) for consecutive ranges of at most grain items covering [0, count),
+    // returns once every range has run. Not reentrant: body must not call ParallelFor.
+    void ParallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& body);
+
+private:
+    // Chunks [begin, end) not yet taken from one thread's share, padded so neighbours do not share a cache line
+    struct ChunkRange {
+        std::mutex mutex;
+        size_t begin = 0;
+        size_t end = 0;
+        char padding[64];
+    };
+
+    void WorkerLoop(unsigned index);
+    void RunChunks(unsigned index);
+    bool TakeChunk(unsigned index, size_t& chunk);
+    bool Steal(unsigned thief);
+
+    std::vector<std::thread> workers;
+    std::unique_ptr<ChunkRange[]> ranges; // One per thread, index 0 is the calling thread
+
+    // Current loop, written under jobMutex before generation is bumped
+    const std::function<void(size_t, size_t)>* jobBody = nullptr;
+    size_t jobCount = 0;
+    size_t jobGrain = 1;
+
+    std::mutex jobMutex;
+    std::condition_variable jobStarted;
+    std::condition_variable jobFinished;
+    unsigned generation = 0;  // Bumped for every loop the workers should join
+    bool jobOpen = false;     // Workers may still join the current loop
+    unsigned activeWorkers = 0;
+    bool stopping = false;
+};
@@ -0,0 +1,173 @@
+#include "Validation.h"
+#include "ParticlePacking.h"
+#include "ParticleRandom.h"
+#include <algorithm>
+#include <iomanip>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+
+// Field order of the comparison and of the tolerance table
+enum ValidatedField {
+    FIELD_POSITION_X, FIELD_POSITION_Y, FIELD_VELOCITY_X, FIELD_VELOCITY_Y,
+    FIELD_COLOR_R, FIELD_COLOR_G, FIELD_COLOR_B, FIELD_COLOR_A, FIELD_AGE, FIELD_LIFETIME, FIELD_RESPAWN_COUNT, FIELD_EMITTER,
+    FIELD_COUNT
+};
+
+static float FieldValue(const Particle& particle, int field) {
+    switch (field) {
+    case FIELD_POSITION_X: return particle.position.x;
+    case FIELD_POSITION_Y: return particle.position.y;
+    case FIELD_VELOCITY_X: return particle.velocity.x;
+    case FIELD_VELOCITY_Y: return particle.velocity.y;
+    case FIELD_COLOR_R: return particle.color.r;
+    case FIELD_COLOR_G: return particle.color.g;
+    case FIELD_COLOR_B: return particle.color.b;
+    case FIELD_COLOR_A: return particle.color.a;
+    case FIELD_AGE: return particle.age;
+    case FIELD_LIFETIME: return particle.lifeTime;
+    case FIELD_RESPAWN_COUNT: return float(particle.respawnCount); // Exact below 2^24 respawns
+    case FIELD_EMITTER: return float(particle.emitter);
+    }
+    return 0.0f;
+}
+
+// Number of representable floats between a and b, 0 for +0 and -0
+static long long UlpDistance(float a, float b) {
+    int32_t ia, ib;
+    std::memcpy(&ia, &a, sizeof(a));
+    std::memcpy(&ib, &b, sizeof(b));
+    // Map the sign-magnitude bit patterns onto one monotonic integer line
+    long long la = ia < 0 ? -(long long)(ia & 0x7fffffff) : ia;
+    long long lb = ib < 0 ? -(long long)(ib & 0x7fffffff) : ib;
+    return std::llabs(la - lb);
+}
+
+// The GPU may round divisions and fused multiply-adds differently from the CPU, everything else must match,
+// including the lifetimes drawn by the shared RNG. Quantized fields of the packed layout can also land one
+// step apart when the unrounded values straddle a step. Rounding differences add up over the substeps of
+// a frame, and once forces act they reach the velocity, including the normalize of a respawn's launch velocity.
+// Emitters redraw the rgb of every life, which then gets quantized as well.
+static std::vector<FieldTolerance> ValidationTolerances(ParticleLayout layout, bool dynamicVelocity, bool emitters, int maxSubsteps) {
+    const bool packed = layout == ParticleLayout::Packed;
+    const float colorStep = packed ? 1.0f / 255.0f : 0.0f;
+    const float rgbEpsilon = emitters ? colorStep * 1.001f : 0.0f;
+    const float ageStep = packed ? PARTICLE_MAX_LIFETIME / 65535.0f : 0.0f;
+    const float halfStep = packed ? 1.0f / 512.0f : 0.0f; // Of a half-float velocity component below 4
+    const int positionUlps = 2 * std::max(maxSubsteps, 1);
+    const int velocityUlps = dynamicVelocity ? 4 * std::max(maxSubsteps, 1) : 0;
+    const float velocityEpsilon = dynamicVelocity ? std::max(1e-7f, halfStep * 1.001f) : 0.0f;
+    std::vector<FieldTolerance> tolerances(FIELD_COUNT);
+    tolerances[FIELD_POSITION_X] = { "position.x", positionUlps, 1e-7f };
+    tolerances[FIELD_POSITION_Y] = { "position.y", positionUlps, 1e-7f };
+    tolerances[FIELD_VELOCITY_X] = { "velocity.x", velocityUlps, velocityEpsilon };
+    tolerances[FIELD_VELOCITY_Y] = { "velocity.y", velocityUlps, velocityEpsilon };
+    tolerances[FIELD_COLOR_R] = { "color.r", 0, rgbEpsilon };
+    tolerances[FIELD_COLOR_G] = { "color.g", 0, rgbEpsilon };
+    tolerances[FIELD_COLOR_B] = { "color.b", 0, rgbEpsilon };
+    tolerances[FIELD_COLOR_A] = { "color.a", 4, std::max(1e-6f, colorStep * 1.001f) };
+    tolerances[FIELD_AGE] = { "age", packed ? 4 : 0, ageStep * 1.001f };
+    tolerances[FIELD_LIFETIME] = { "lifetime", 0, 0.0f };
+    tolerances[FIELD_RESPAWN_COUNT] = { "respawn_count", 0, 0.0f };
+    tolerances[FIELD_EMITTER] = { "emitter", 0, 0.0f };
+    return tolerances;
+}
+
+void SimulationValidator::Init(const std::vector<Particle>& initialParticles, ParticleLayout particleLayout, glm::vec2 gravity, ParticleIntegrator integrator, int maxSubsteps,
+    const std::vector<EmitterParams>* emitters, unsigned threadCount, uint32_t randomSeed) {
+    layout = particleLayout;
+    tolerances = ValidationTolerances(layout, gravity != glm::vec2(0.0f) || emitters, emitters != nullptr, maxSubsteps);
+    reference.Init(initialParticles, threadCount, randomSeed);
+    reference.SetForces(gravity, integrator);
+    reference.SetEmitters(emitters);
+    expected = initialParticles;
+    if (layout == ParticleLayout::Packed) {
+        QuantizeExpected(); // The GPU starts from the quantized state
+        reference.SetParticles(expected);
+    }
+    firstDivergence = {};
+    divergentParticles = 0;
+    divergentFrame = -1;
+    framesChecked = 0;
+}
+
+float SimulationValidator::DeltaTime(int frame) {
+    // Typical refresh rates plus a long hitch, so respawns happen within a few hundred frames
+    static const float DELTA_TIMES[] = { 1.0f / 60.0f, 1.0f / 144.0f, 1.0f / 30.0f, 0.1f, 1.0f / 75.0f };
+    return DELTA_TIMES[frame % (sizeof(DELTA_TIMES) / sizeof(DELTA_TIMES[0]))];
+}
+
+glm::vec2 SimulationValidator::MousePosition(int frame) {
+    // Held for a while each, the way a cursor moves
+    static const glm::vec2 POSITIONS[] = { glm::vec2(0.0f, 0.0f), glm::vec2(0.5f, -0.25f), glm::vec2(-0.75f, 0.6f), glm::vec2(0.2f, 0.9f) };
+    return POSITIONS[(frame / 17) % (sizeof(POSITIONS) / sizeof(POSITIONS[0]))];
+}
+
+bool SimulationValidator::Check(int frame, float deltaTime, int substeps, const std::vector<Particle>& gpuParticles) {
+    if (!Passed()) {
+        return false;
+    }
+
+    reference.Update(deltaTime, substeps, MousePosition(frame));
+    reference.ReadParticles(expected);
+    if (layout == ParticleLayout::Packed) {
+        QuantizeExpected(); // Stored the way the shader stores it
+    }
+
+    for (size_t i = 0; i < expected.size() && i < gpuParticles.size(); ++i) {
+        for (int field = 0; field < FIELD_COUNT; ++field) {
+            float gpu = FieldValue(gpuParticles[i], field);
+            float cpu = FieldValue(expected[i], field);
+            long long ulps = UlpDistance(gpu, cpu);
+            const FieldTolerance& tolerance = tolerances[field];
+            if (ulps <= tolerance.maxUlps || std::abs(gpu - cpu) <= tolerance.epsilon) {
+                continue;
+            }
+            if (divergentParticles == 0) {
+                firstDivergence = { i, field, gpu, cpu, ulps };
+                divergentFrame = frame;
+            }
+            ++divergentParticles;
+            break; // Count particles, not fields
+        }
+    }
+    if (gpuParticles.size() != expected.size() && divergentParticles == 0) {
+        firstDivergence = { std::min(gpuParticles.size(), expected.size()), 0, 0.0f, 0.0f, 0 };
+        divergentFrame = frame;
+        divergentParticles = 1;
+    }
+    ++framesChecked;
+
+    // Next frame starts from exactly what the GPU has
+    reference.SetParticles(gpuParticles);
+    return Passed();
+}
+
+void SimulationValidator::QuantizeExpected() {
+    for (Particle& particle : expected) {
+        Particle quantized = UnpackParticle(PackParticle(particle), particle.lifeTime); // The lifetime is derived, never quantized
+        quantized.emitter = particle.emitter; // Kept in a stream of its own
+        particle = quantized;
+    }
+}
+
+void SimulationValidator::Report(std::ostream& out) const {
+    out << "=== Validation ===\n"
+        << "layout: " << ParticleLayoutName(layout) << "\n"
+        << "frames_checked: " << framesChecked << "\n";
+    if (Passed()) {
+        out << "result: passed" << std::endl;
+        return;
+    }
+    const FieldTolerance& tolerance = tolerances[firstDivergence.field];
+    out << std::setprecision(9)
+        << "result: diverged\n"
+        << "first_divergent_frame: " << divergentFrame << "\n"
+        << "first_divergent_particle: " << firstDivergence.particle << "\n"
+        << "field: " << tolerance.name << "\n"
+        << "gpu: " << firstDivergence.gpu << "\n"
+        << "reference: " << firstDivergence.reference << "\n"
+        << "ulps: " << firstDivergence.ulps << " (tolerance " << tolerance.maxUlps << " ulps or " << tolerance.epsilon << ")\n"
+        << "divergent_particles: " << divergentParticles << std::endl;
+}
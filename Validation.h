@@ -0,0 +1,59 @@
+#pragma once
+#include <glm.hpp>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+#include "Particle.h"
+#include "CpuSimulation.h"
+
+// A field matches when it is within maxUlps representable floats or within epsilon of the reference
+struct FieldTolerance {
+    const char* name;
+    int maxUlps;
+    float epsilon;
+};
+
+// Steps a CPU reference alongside the compute shader and compares the two every frame.
+// Both sides start each frame from the same state: after the comparison the reference takes over the
+// GPU result, so a reported divergence is the error of one update and not drift accumulated over the run.
+class SimulationValidator {
+public:
+    // gravity and integrator must match the compute shader's variant, maxSubsteps is the most substeps a frame may run.
+    // emitters is the table the shader reads, null without one; the reference respawns from the same host copy.
+    void Init(const std::vector<Particle>& initialParticles, ParticleLayout layout, glm::vec2 gravity, ParticleIntegrator integrator, int maxSubsteps,
+        const std::vector<EmitterParams>* emitters, unsigned threadCount, uint32_t seed);
+
+    // Fixed inputs of a validation run, so every run and every backend sees the same frames
+    static float DeltaTime(int frame);
+    static glm::vec2 MousePosition(int frame);
+
+    // Runs the reference update for the frame, substeps steps of deltaTime like the dispatch, and compares it
+    // with what the GPU produced from the same state. Returns false once a frame has diverged; only the first
+    // divergent frame is recorded.
+    bool Check(int frame, float deltaTime, int substeps, const std::vector<Particle>& gpuParticles);
+
+    bool Passed() const { return divergentFrame < 0; }
+    int FramesChecked() const { return framesChecked; }
+    void Report(std::ostream& out) const;
+
+private:
+    struct Divergence {
+        size_t particle;
+        int field;
+        float gpu;
+        float reference;
+        long long ulps;
+    };
+
+    // Replaces expected with what the packed layout stores of it
+    void QuantizeExpected();
+
+    std::vector<FieldTolerance> tolerances;
+    CpuSimulation reference;
+    ParticleLayout layout = ParticleLayout::AoS;
+    std::vector<Particle> expected;
+    Divergence firstDivergence = {};
+    size_t divergentParticles = 0; // In the first divergent frame
+    int divergentFrame = -1;
+    int framesChecked = 0;
+};
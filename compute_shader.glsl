@@ -1,46 +1,432 @@
 #version 430 core
 
-layout (local_size_x = 10) in;
-
-struct Particle {
-    vec2 position;
-    vec2 velocity;
-    vec4 color;
-    float age;
-    float lifeTime;
+// LOCAL_SIZE_X, PARTICLE_COUNT and the layout, pass and integrator switches are injected by the host
+// Storage bindings are fixed; the host lists them (ParticleStorage::StreamBindings, ParticleLists and
+// ParticleEmitters::StorageBindings, RadixSort::SortKeyBindings for SORT_KEYS_PASS) to check a variant
+// against the driver's limits, keep them in step
+layout (local_size_x = LOCAL_SIZE_X) in;
+
+#include "particle_common.glsl"
+#ifdef EMITTERS
+#include "particle_emitters.glsl"
+#endif
+
+uniform vec2 mousePos;
+uniform float deltaTime; // Length of one fixed step
+uniform uint substeps;   // Steps this dispatch advances the simulation by, 0 when the frame was shorter than a step
+#ifdef DYNAMIC_VELOCITY
+uniform vec2 gravity;    // Forces change the velocity, otherwise it never changes after launch
+#endif
+#ifdef FORCE_FIELD
+uniform float fieldStrength; // Acceleration of one unit of the baked field
+uniform float fieldSlice;    // Where the frame's time falls in the ring of baked slices, constant over a dispatch
+layout(binding = 0) uniform sampler3D forceField; // Curl noise over NDC [-1, 1] from CurlNoiseField, one layer per time slice
+#endif
+
+// Lifetime of a particle's life number respawnCount, drawn from its emitter's range when there is an emitter table
+float particleLifetime(uint id, uint respawnCount, uint emitter) {
+#ifdef EMITTERS
+    return emitterLifetime(emitter, id, respawnCount);
+#else
+    return particleLifetime(id, respawnCount);
+#endif
+}
+
+#if defined(EMITTERS) && (defined(PARTICLE_LAYOUT_SOA) || defined(PARTICLE_LAYOUT_PACKED))
+// Emitter of every particle in a stream of its own. Only the emit pass changes it, and only for dead slots
+// nothing reads, so it is never double-buffered
+#ifdef EMIT_PASS
+layout(std430, binding = 18) buffer EmitterIndexBuffer { uint emitterIndices[]; };
+#else
+layout(std430, binding = 18) readonly buffer EmitterIndexBuffer { uint emitterIndices[]; };
+#endif
+#endif
+
+// The emitter stream of the SoA and packed layouts, absent without emitters
+uint loadEmitter(uint id) {
+#if defined(EMITTERS) && (defined(PARTICLE_LAYOUT_SOA) || defined(PARTICLE_LAYOUT_PACKED))
+    return emitterIndices[id];
+#else
+    return 0u;
+#endif
+}
+
+void storeEmitter(uint id, uint emitter) {
+#if defined(EMITTERS) && (defined(PARTICLE_LAYOUT_SOA) || defined(PARTICLE_LAYOUT_PACKED)) && defined(EMIT_PASS)
+    emitterIndices[id] = emitter;
+#endif
+}
+
+#if defined(PARTICLE_LAYOUT_SOA)
+// One buffer per field, the update only moves the fields it touches
+#ifdef PING_PONG
+layout(std430, binding = 0) readonly buffer PositionInBuffer { vec2 positionsIn[]; };
+layout(std430, binding = 2) readonly buffer ColorInBuffer { vec4 colorsIn[]; };
+layout(std430, binding = 3) readonly buffer AgeInBuffer { float agesIn[]; };
+layout(std430, binding = 4) readonly buffer RespawnCountInBuffer { uint respawnCountsIn[]; };
+layout(std430, binding = 5) writeonly buffer PositionOutBuffer { vec2 positionsOut[]; };
+layout(std430, binding = 6) writeonly buffer ColorOutBuffer { vec4 colorsOut[]; };
+layout(std430, binding = 7) writeonly buffer AgeOutBuffer { float agesOut[]; };
+layout(std430, binding = 8) writeonly buffer RespawnCountOutBuffer { uint respawnCountsOut[]; };
+#else
+layout(std430, binding = 0) buffer PositionBuffer { vec2 positions[]; };
+layout(std430, binding = 2) buffer ColorBuffer { vec4 colors[]; };
+layout(std430, binding = 3) buffer AgeBuffer { float ages[]; };
+layout(std430, binding = 4) buffer RespawnCountBuffer { uint respawnCounts[]; };
+#define positionsIn positions
+#define positionsOut positions
+#define colorsIn colors
+#define colorsOut colors
+#define agesIn ages
+#define agesOut ages
+#define respawnCountsIn respawnCounts
+#define respawnCountsOut respawnCounts
+#endif
+#if defined(DYNAMIC_VELOCITY) && defined(PING_PONG)
+layout(std430, binding = 1) readonly buffer VelocityInBuffer { vec2 velocitiesIn[]; };
+layout(std430, binding = 15) writeonly buffer VelocityOutBuffer { vec2 velocitiesOut[]; };
+#elif defined(DYNAMIC_VELOCITY)
+layout(std430, binding = 1) buffer VelocityBuffer { vec2 velocities[]; };
+#define velocitiesIn velocities
+#define velocitiesOut velocities
+#else
+// Without forces the velocity never changes after init, so it is never double-buffered
+layout(std430, binding = 1) readonly buffer VelocityBuffer { vec2 velocities[]; };
+#define velocitiesIn velocities
+#endif
+
+uint particleBufferLength() {
+    return uint(agesIn.length());
+}
+
+Particle loadParticle(uint id) {
+    Particle particle;
+    particle.position = positionsIn[id];
+    particle.velocity = velocitiesIn[id];
+    particle.color = colorsIn[id]; // Only alpha is used without ping-pong, the compiler drops the rest of the load
+    particle.age = agesIn[id];
+    particle.respawnCount = respawnCountsIn[id];
+    particle.emitter = loadEmitter(id);
+    particle.lifeTime = particleLifetime(id, particle.respawnCount, particle.emitter); // Derived, not stored
+    return particle;
+}
+
+void storeParticle(uint id, Particle particle) {
+    positionsOut[id] = particle.position;
+#ifdef DYNAMIC_VELOCITY
+    velocitiesOut[id] = particle.velocity;
+#endif
+#if defined(PING_PONG) || defined(EMITTERS)
+    colorsOut[id] = particle.color; // Emitters draw the rgb of every life, the other buffer needs the unchanged rgb as well
+#else
+    colorsOut[id].a = particle.color.a; // rgb never changes
+#endif
+    agesOut[id] = particle.age;
+    respawnCountsOut[id] = particle.respawnCount;
+    storeEmitter(id, particle.emitter);
+}
+#elif defined(PARTICLE_LAYOUT_PACKED)
+// 20 bytes per particle: float position, half-float velocity, RGBA8 color, 16-bit age and respawn count.
+// The lifetime is derived from the respawn count.
+struct PackedParticle {
+    float positionX; // Scalars only, a vec2 member would round the std430 stride up to 24 bytes
+    float positionY;
+    uint velocity;    // packHalf2x16
+    uint color;       // packUnorm4x8
+    uint ageRespawn;  // Age as a unorm16 fraction of the lifetime in the low half, respawn count in the high half
 };
 
+#ifdef PING_PONG
+layout(std430, binding = 0) readonly buffer PackedParticleInBuffer {
+    PackedParticle packedParticlesIn[];
+};
+layout(std430, binding = 1) writeonly buffer PackedParticleOutBuffer {
+    PackedParticle packedParticlesOut[];
+};
+#else
+layout(std430, binding = 0) buffer PackedParticleBuffer {
+    PackedParticle packedParticles[];
+};
+#define packedParticlesIn packedParticles
+#define packedParticlesOut packedParticles
+#endif
+
+uint particleBufferLength() {
+    return uint(packedParticlesIn.length());
+}
+
+Particle loadParticle(uint id) {
+    PackedParticle record = packedParticlesIn[id];
+    Particle particle;
+    particle.position = vec2(record.positionX, record.positionY);
+    particle.velocity = unpackHalf2x16(record.velocity);
+    particle.color = unpackUnorm4x8(record.color);
+    particle.respawnCount = record.ageRespawn >> 16u;
+    particle.emitter = loadEmitter(id);
+    particle.lifeTime = particleLifetime(id, particle.respawnCount, particle.emitter);
+    particle.age = unpackUnorm2x16(record.ageRespawn).x * particle.lifeTime;
+    return particle;
+}
+
+void storeParticle(uint id, Particle particle) {
+    packedParticlesOut[id].positionX = particle.position.x;
+    packedParticlesOut[id].positionY = particle.position.y;
+#if defined(PING_PONG) || defined(DYNAMIC_VELOCITY)
+    packedParticlesOut[id].velocity = packHalf2x16(particle.velocity); // Changed by forces, or unchanged but the other buffer needs it too
+#endif
+    packedParticlesOut[id].color = packUnorm4x8(particle.color);
+    packedParticlesOut[id].ageRespawn = (packUnorm2x16(vec2(particle.age / particle.lifeTime, 0.0)) & 0xFFFFu) | (particle.respawnCount << 16u);
+    storeEmitter(id, particle.emitter);
+}
+#else
+// One std430 record per particle
+#ifdef PING_PONG
+// Last frame's state is read from one buffer and the new state written to the other
+layout(std430, binding = 0) readonly buffer ParticleInBuffer {
+    Particle particlesIn[];
+};
+layout(std430, binding = 1) writeonly buffer ParticleOutBuffer {
+    Particle particlesOut[];
+};
+#else
 layout(std430, binding = 0) buffer ParticleBuffer {
     Particle particles[];
 };
+#define particlesIn particles
+#define particlesOut particles
+#endif
 
-uniform vec2 mousePos;
-uniform float deltaTime;
+uint particleBufferLength() {
+    return uint(particlesIn.length());
+}
 
-float generateRandomLifetime(uint id) {
-    float randomValue = fract(sin(float(id) * 78.233 + deltaTime) * 43758.5453123);
-    return mix(1.0, 5.0, randomValue); // Lifetime between 1 and 5 seconds
+Particle loadParticle(uint id) {
+    return particlesIn[id];
 }
 
+void storeParticle(uint id, Particle particle) {
+    particlesOut[id] = particle;
+}
+#endif
+
+// PARTICLE_COUNT is injected by the host, bounds checks then compare against a constant
+uint particleCount() {
+#ifdef PARTICLE_COUNT
+    return PARTICLE_COUNT;
+#else
+    return particleBufferLength();
+#endif
+}
+
+// Puts a particle back at the emitter with a fresh lifetime
+void respawn(uint id, inout Particle particle) {
+    particle.age = 0.0;
+    particle.respawnCount += 1u;
+#ifdef EMITTERS
+    // Every emitter of the table respawns in this same dispatch, each from its own entry
+    particle.position = emitters[particle.emitter].position;
+    particle.lifeTime = particleLifetime(id, particle.respawnCount, particle.emitter);
+    particle.color = emitterColor(particle.emitter, id, particle.respawnCount); // Full opacity
+    particle.velocity = emitterLaunchVelocity(particle.emitter, id, particle.respawnCount);
+#else
+    particle.position = mousePos;
+    particle.lifeTime = particleLifetime(id, particle.respawnCount);
+    particle.color.a = 1.0; // Restore full opacity
+#ifdef DYNAMIC_VELOCITY
+    particle.velocity = particleLaunchVelocity(id); // Forces of the last life must not carry over
+#endif
+#endif
+}
+
+// Acceleration of a particle at position, constant zero without forces so every integrator reduces to
+// position += velocity * deltaTime and the velocity is left alone
+vec2 particleAcceleration(vec2 position) {
+#if defined(DYNAMIC_VELOCITY) && defined(FORCE_FIELD)
+    // The sampler filters between texels and between the two slices around the frame's time
+    return gravity + fieldStrength * textureLod(forceField, vec3(position * 0.5 + 0.5, fieldSlice), 0.0).xy;
+#elif defined(DYNAMIC_VELOCITY)
+    return gravity;
+#else
+    return vec2(0.0);
+#endif
+}
+
+// Advances position and velocity by one step with the integrator variant the host selected.
+// acceleration holds particleAcceleration(position) on entry and is updated for the next step,
+// so each step evaluates the forces once.
+void integrate(inout Particle particle, inout vec2 acceleration) {
+#if defined(INTEGRATOR_VELOCITY_VERLET)
+    particle.position += (particle.velocity + 0.5 * deltaTime * acceleration) * deltaTime;
+    vec2 next = particleAcceleration(particle.position);
+    particle.velocity += 0.5 * (acceleration + next) * deltaTime;
+    acceleration = next;
+#elif defined(INTEGRATOR_SEMI_IMPLICIT_EULER)
+    particle.velocity += acceleration * deltaTime;
+    particle.position += particle.velocity * deltaTime;
+    acceleration = particleAcceleration(particle.position);
+#else
+    particle.position += particle.velocity * deltaTime;
+    particle.velocity += acceleration * deltaTime;
+    acceleration = particleAcceleration(particle.position);
+#endif
+}
+
+// Flatten the 2D dispatch grid used once the group count passes the device limit in x
+uint globalIndex() {
+    return gl_GlobalInvocationID.y * gl_NumWorkGroups.x * gl_WorkGroupSize.x + gl_GlobalInvocationID.x;
+}
+
+#ifdef PARTICLE_LISTS
+// Pooled particles: only slots on the alive list are simulated and drawn, dead slots wait on the dead list
+// until the emitter pops them. list_prepare_shader.glsl sizes both dispatches from these counts.
+#include "particle_list_state.glsl"
+layout(std430, binding = 10) readonly buffer AliveInBuffer { uint aliveIn[]; };
+#ifdef SORT_KEYS_PASS
+layout(std430, binding = 11) readonly buffer AliveOutBuffer { uint aliveOut[]; }; // The list the frame draws
+#else
+layout(std430, binding = 11) writeonly buffer AliveOutBuffer { uint aliveOut[]; };
+#endif
+layout(std430, binding = 12) buffer DeadBuffer { uint deadList[]; };
+
+#if defined(SORT_KEYS_PASS)
+// Sorting only needs the particles the frame draws
+uint drawCount() {
+    return nextAliveCount;
+}
+
+uint drawnParticle(uint index) {
+    return aliveOut[index];
+}
+#elif defined(EMIT_PASS)
+#ifdef EMITTERS
+// The prepare pass gave each emitter a contiguous range of the popped slots, starting at its firstSlot.
+// The last emitter starting at or before index owns it; emitters that got nothing share their firstSlot
+// with the next one and are skipped.
+uint emitterOfSlot(uint index) {
+    uint low = 0u;
+    uint high = EMITTER_COUNT - 1u;
+    while (low < high) {
+        uint middle = (low + high + 1u) / 2u;
+        if (emitterStates[middle].firstSlot <= index) {
+            low = middle;
+        } else {
+            high = middle - 1u;
+        }
+    }
+    return low;
+}
+#endif
+
+// One invocation per popped slot; runs before the simulate pass pushes this frame's deaths onto the same entries
+void main() {
+    uint index = globalIndex();
+    if (index < emitCount) {
+        uint id = deadList[emitBase + index];
+        Particle particle = loadParticle(id); // Without emitters it keeps its velocity and color from its last life
+#ifdef EMITTERS
+        particle.emitter = emitterOfSlot(index);
+#endif
+        respawn(id, particle);
+        storeParticle(id, particle);
+        aliveOut[atomicAdd(nextAliveCount, 1u)] = id;
+    }
+}
+#else
 void main() {
-    uint id = gl_GlobalInvocationID.x;
-    if (id < particles.length()) {
-        // Increment age
-        particles[id].age += deltaTime;
-
-        // Fade effect as the particle's age approaches its lifetime
-        particles[id].color.a = 1.0 - (particles[id].age / particles[id].lifeTime);
-
-        // Check if age exceeds lifetime
-        if (particles[id].age >= particles[id].lifeTime) {
-            // Reset particle position, age, and restore opacity
-            particles[id].position = mousePos;
-            particles[id].age = 0.0;
-            particles[id].lifeTime = generateRandomLifetime(id); 
-            particles[id].color.a = 1.0; // Restore full opacity
+    uint index = globalIndex();
+    if (index < aliveCount) {
+        uint id = aliveIn[index];
+        Particle particle = loadParticle(id);
+
+        // Every substep of the frame in registers, one load and one store per particle
+        vec2 acceleration = particleAcceleration(particle.position);
+        bool alive = true;
+        for (uint step = 0u; step < substeps && alive; ++step) {
+            // Increment age
+            particle.age += deltaTime;
+
+            // Fade effect as the particle's age approaches its lifetime
+            particle.color.a = 1.0 - (particle.age / particle.lifeTime);
+
+            if (particle.age >= particle.lifeTime) {
+                // Back to the pool, the emitter decides when the slot lives again
+                particle.color.a = 0.0;
+                alive = false;
+            } else {
+                integrate(particle, acceleration);
+            }
+        }
+        if (alive) {
+            aliveOut[atomicAdd(nextAliveCount, 1u)] = id;
         } else {
-            // Update particle position
-            particles[id].position += particles[id].velocity * deltaTime;
+            deadList[atomicAdd(deadCount, 1u)] = id;
         }
+
+        storeParticle(id, particle);
     }
-}
\ No newline at end of file
+}
+#endif
+#elif defined(SORT_KEYS_PASS)
+uint drawCount() {
+    return particleCount();
+}
+
+uint drawnParticle(uint index) {
+    return index;
+}
+#else
+void main() {
+    uint id = globalIndex();
+    if (id < particleCount()) {
+        Particle particle = loadParticle(id);
+
+        // Every substep of the frame in registers, one load and one store per particle
+        vec2 acceleration = particleAcceleration(particle.position);
+        for (uint step = 0u; step < substeps; ++step) {
+            // Increment age
+            particle.age += deltaTime;
+
+            // Fade effect as the particle's age approaches its lifetime
+            particle.color.a = 1.0 - (particle.age / particle.lifeTime);
+
+            // Check if age exceeds lifetime
+            if (particle.age >= particle.lifeTime) {
+                // Reset particle position, age, and restore opacity
+                respawn(id, particle);
+                acceleration = particleAcceleration(particle.position);
+            } else {
+                integrate(particle, acceleration);
+            }
+        }
+
+        storeParticle(id, particle);
+    }
+}
+#endif
+
+#ifdef SORT_KEYS_PASS
+// Key and value for every drawn particle, radix_sort_shader.glsl orders them for a back-to-front draw.
+// The key is the remaining fraction of the lifetime: the most faded particles are drawn first and
+// fresh, opaque ones blend over them. Entries past the drawn ones get SORT_KEY_MAX and sort to the end.
+// Compiled without PING_PONG, the host binds the buffers the frame just wrote.
+#define SORT_KEY_MAX 0xFFFFu
+layout(std430, binding = 13) writeonly buffer SortKeys { uint sortKeys[]; };
+layout(std430, binding = 14) writeonly buffer SortValues { uint sortValues[]; };
+
+void main() {
+    uint index = globalIndex();
+    if (index >= particleCount()) {
+        return;
+    }
+    uint key = SORT_KEY_MAX;
+    uint id = index;
+    if (index < drawCount()) {
+        id = drawnParticle(index);
+        Particle particle = loadParticle(id);
+        float remaining = clamp(1.0 - particle.age / particle.lifeTime, 0.0, 1.0);
+        key = uint(remaining * float(SORT_KEY_MAX - 1u));
+    }
+    sortKeys[index] = key;
+    sortValues[index] = id;
+}
+#endif
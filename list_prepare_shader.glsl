@@ -0,0 +1,58 @@
+#version 430 core
+
+// Runs once per frame before the emit and simulate passes of the pooled particle mode.
+// LOCAL_SIZE_X (of the particle passes) and MAX_GROUPS_X are injected by the host, and the emitter
+// switches when the particles come from an emitter table.
+layout (local_size_x = 1) in;
+
+#include "particle_list_state.glsl"
+
+#ifdef EMITTERS
+#include "particle_common.glsl"
+#include "particle_emitters.glsl"
+
+uniform float simulatedTime; // Time the frame's substeps cover, emission follows it
+
+// Every emitter's share of the frame at its own rate, laid out one after the other. firstSlot tells the
+// emit pass which popped slots each one revives. When the dead list runs short the later emitters get fewer.
+uint requestEmission() {
+    uint request = 0u;
+    for (uint e = 0u; e < EMITTER_COUNT; ++e) {
+        float due = emitterStates[e].accumulator + emitters[e].rate * simulatedTime;
+        uint count = uint(due);
+        emitterStates[e].accumulator = due - float(count);
+        emitterStates[e].firstSlot = request;
+        request += count;
+    }
+    return request;
+}
+#else
+uniform uint emitRequest; // Particles the emitter wants this frame, the dead list may hold fewer
+
+uint requestEmission() {
+    return emitRequest;
+}
+#endif
+
+// Work groups for count invocations, folded into 2D rows past the device limit like ComputeDispatchSize()
+void writeDispatch(uint count, out uint dispatch[3]) {
+    uint groups = (count + LOCAL_SIZE_X - 1u) / LOCAL_SIZE_X;
+    uint rows = max((groups + MAX_GROUPS_X - 1u) / MAX_GROUPS_X, 1u);
+    dispatch[0] = (groups + rows - 1u) / rows;
+    dispatch[1] = rows;
+    dispatch[2] = 1u;
+}
+
+void main() {
+    // Last frame's survivors are this frame's input
+    aliveCount = nextAliveCount;
+    nextAliveCount = 0u;
+
+    // Pop from the top of the dead list
+    emitCount = min(requestEmission(), deadCount);
+    deadCount -= emitCount;
+    emitBase = deadCount;
+
+    writeDispatch(emitCount, emitDispatch);
+    writeDispatch(aliveCount, simulateDispatch);
+}
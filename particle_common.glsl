@@ -0,0 +1,46 @@
+// Shared by every shader that touches particle state: the particle as the update sees it,
+// whatever the memory layout, and the RNG that decides its lifetimes. Mirrors Particle.h and ParticleRandom.h.
+
+struct Particle {
+    vec2 position;
+    vec2 velocity;
+    vec4 color;
+    float age;
+    float lifeTime;    // Always particleLifetime(id, respawnCount), or emitterLifetime() of its emitter
+    uint respawnCount; // Respawns so far, the RNG counter of the current lifetime
+    uint emitter;      // Index into the emitter table, 0 without emitters
+};
+
+uniform uint seed;
+
+// Counter-based RNG, the same as ParticleRandom.h on the host: the pcg3d hash of (id, counter, seed).
+// No state carries between frames and only integer operations are used, so every backend draws the same numbers.
+uvec3 particleRandom(uint id, uint counter) {
+    uvec3 v = uvec3(id, counter, seed) * 1664525u + 1013904223u;
+    v.x += v.y * v.z;
+    v.y += v.z * v.x;
+    v.z += v.x * v.y;
+    v ^= v >> 16u;
+    v.x += v.y * v.z;
+    v.y += v.z * v.x;
+    v.z += v.x * v.y;
+    return v;
+}
+
+// Uniform in [0, 1) from the top 22 bits, scaling it by 1.5 or 4 below is exact whether or not it is fused
+float randomUnit(uint bits) {
+    return float(bits >> 10u) * (1.0 / 4194304.0);
+}
+
+// First lifetime in [1.5, 3) seconds, respawns in [1, 5)
+float particleLifetime(uint id, uint respawnCount) {
+    float t = randomUnit(particleRandom(id, respawnCount).x);
+    return respawnCount == 0u ? 1.5 + 1.5 * t : 1.0 + 4.0 * t;
+}
+
+// Direction from the RNG at PARTICLE_LAUNCH_SPEED, the velocity every particle starts with
+vec2 particleLaunchVelocity(uint id) {
+    uvec3 bits = particleRandom(id, 0u); // x is the first lifetime
+    vec2 direction = vec2(randomUnit(bits.y), randomUnit(bits.z)) * 2.0 - 1.0;
+    return normalize(direction) * (0.2 + 0.005);
+}
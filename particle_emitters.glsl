@@ -0,0 +1,54 @@
+// Emitter table of compute_shader.glsl and list_prepare_shader.glsl, mirrors ParticleEmitters.h.
+// EMITTER_COUNT is injected by the host. Needs particle_common.glsl included first.
+
+struct Emitter {
+    vec3 colorMin;  // Each rgb channel of a new life is drawn between the two
+    float spread;   // Tangent of the launch cone's half angle
+    vec3 colorMax;
+    float rate;     // Particles per second, only pooled emission uses it
+    vec2 position;  // Where its particles respawn
+    vec2 lifetime;  // Range of a life's length in seconds
+    vec2 speed;     // Range of the launch speed
+    vec2 direction; // Unit axis of the launch cone
+};
+
+// What the GPU tracks per emitter in pooled mode
+struct EmitterState {
+    float accumulator; // Fractional particles carried over to the next frame
+    uint firstSlot;    // First of this frame's popped slots the emitter revives
+};
+
+layout(std430, binding = 16) readonly buffer EmitterBuffer { Emitter emitters[]; };
+layout(std430, binding = 17) buffer EmitterStateBuffer { EmitterState emitterStates[]; }; // Written by the prepare pass
+
+// OR'd into the respawn count for the color draws of a life, respawn counts never get this far
+#define EMITTER_COLOR_COUNTER 0x80000000u
+
+// a + (b - a) * t for the 12-bit draw t in the top bits of bits, in 16.16 fixed point. Integer operations
+// only, so it rounds the same on every backend, fused or not, like EmitterRange() in ParticleEmitters.h.
+// Needs 0 <= a <= b and b - a below 16.
+float emitterRange(float a, float b, uint bits) {
+    uint low = uint(a * 65536.0);
+    uint span = uint(b * 65536.0) - low;
+    return float(low + ((span * (bits >> 20u)) >> 12u)) * (1.0 / 65536.0);
+}
+
+// The draws of a particle's life number respawnCount, the same as ParticleEmitters.h
+float emitterLifetime(uint emitter, uint id, uint respawnCount) {
+    return emitterRange(emitters[emitter].lifetime.x, emitters[emitter].lifetime.y, particleRandom(id, respawnCount).x);
+}
+
+vec2 emitterLaunchVelocity(uint emitter, uint id, uint respawnCount) {
+    Emitter source = emitters[emitter];
+    uvec3 bits = particleRandom(id, respawnCount); // x is the lifetime
+    float offset = source.spread * (randomUnit(bits.y) * 2.0 - 1.0);
+    vec2 direction = source.direction + vec2(-source.direction.y, source.direction.x) * offset;
+    return normalize(direction) * emitterRange(source.speed.x, source.speed.y, bits.z);
+}
+
+vec4 emitterColor(uint emitter, uint id, uint respawnCount) {
+    Emitter source = emitters[emitter];
+    uvec3 bits = particleRandom(id, respawnCount | EMITTER_COLOR_COUNTER);
+    return vec4(emitterRange(source.colorMin.r, source.colorMax.r, bits.x), emitterRange(source.colorMin.g, source.colorMax.g, bits.y),
+        emitterRange(source.colorMin.b, source.colorMax.b, bits.z), 1.0);
+}
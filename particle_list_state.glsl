@@ -0,0 +1,13 @@
+// State of the pooled particle mode (ParticleListState in ParticleLists.h), shared by the
+// list passes of compute_shader.glsl and by list_prepare_shader.glsl
+
+layout(std430, binding = 9) buffer ParticleListState {
+    uint emitDispatch[3];     // glDispatchComputeIndirect arguments of the emit pass
+    uint simulateDispatch[3]; // ... and of the simulate pass
+    uint drawCommand[5];      // glDrawElementsIndirect arguments, the count is copied from nextAliveCount
+    uint aliveCount;          // Entries of the current alive list (AliveInBuffer)
+    uint nextAliveCount;      // Entries appended to the next alive list (AliveOutBuffer) this frame
+    uint deadCount;           // Entries of the dead list (DeadBuffer)
+    uint emitCount;           // Slots popped off the dead list this frame
+    uint emitBase;            // First of them
+};
@@ -0,0 +1,201 @@
+#version 430 core
+
+// LSD radix sort of uint keys carrying uint values, RADIX_BITS per pass. Driven by RadixSort.cpp, which
+// builds one program per entry point: RADIX_HISTOGRAM, RADIX_SCATTER, SCAN_BLOCKS and SCAN_ADD.
+// LOCAL_SIZE_X and ITEMS_PER_THREAD are injected by the host. Every work group owns one tile of
+// TILE_SIZE elements, each invocation a contiguous run of ITEMS_PER_THREAD of them, which keeps the
+// scatter stable: equal digits keep their order within an invocation, across invocations and across tiles.
+layout (local_size_x = LOCAL_SIZE_X) in;
+
+#define RADIX_BITS 4u
+#define RADIX_BINS 16u
+#define TILE_SIZE (LOCAL_SIZE_X * ITEMS_PER_THREAD)
+
+uniform uint count;     // Elements to sort, or entries to scan
+uniform uint shift;     // Bit offset of this pass's digit
+uniform uint tileCount; // Work groups covering count, the histogram holds RADIX_BINS * tileCount entries
+
+// Digit-major histogram: entry digit * tileCount + tile. One exclusive scan over it turns every count
+// into the position the tile's first element of that digit goes to.
+layout(std430, binding = 4) buffer ScanData { uint scanData[]; };
+layout(std430, binding = 5) buffer BlockSums { uint blockSums[]; };
+
+// Work groups may be folded into a 2D grid like the particle dispatches, surplus groups exit uniformly
+uint tileIndex() {
+    return gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x;
+}
+
+shared uint scanShared[LOCAL_SIZE_X];
+
+// Exclusive prefix sum of one value per invocation across the work group, total receives the sum of all of them
+uint groupExclusiveScan(uint value, out uint total) {
+    uint t = gl_LocalInvocationID.x;
+    scanShared[t] = value;
+    memoryBarrierShared();
+    barrier();
+    for (uint offset = 1u; offset < LOCAL_SIZE_X; offset <<= 1u) {
+        uint addend = t >= offset ? scanShared[t - offset] : 0u;
+        barrier();
+        scanShared[t] += addend;
+        memoryBarrierShared();
+        barrier();
+    }
+    uint inclusive = scanShared[t];
+    total = scanShared[LOCAL_SIZE_X - 1u];
+    barrier(); // The next call overwrites scanShared
+    return inclusive - value;
+}
+
+#if defined(RADIX_HISTOGRAM) || defined(RADIX_SCATTER)
+layout(std430, binding = 0) readonly buffer KeysIn { uint keysIn[]; };
+
+uint digitOf(uint key) {
+    return (key >> shift) & (RADIX_BINS - 1u);
+}
+#endif
+
+#if defined(RADIX_HISTOGRAM)
+shared uint digitCounts[RADIX_BINS];
+
+// Counts the digits of one tile
+void main() {
+    uint tile = tileIndex();
+    if (tile >= tileCount) {
+        return;
+    }
+    uint t = gl_LocalInvocationID.x;
+    if (t < RADIX_BINS) {
+        digitCounts[t] = 0u;
+    }
+    memoryBarrierShared();
+    barrier();
+
+    uint first = tile * TILE_SIZE + t * ITEMS_PER_THREAD;
+    for (uint i = 0u; i < ITEMS_PER_THREAD; ++i) {
+        if (first + i < count) {
+            atomicAdd(digitCounts[digitOf(keysIn[first + i])], 1u);
+        }
+    }
+    memoryBarrierShared();
+    barrier();
+
+    if (t < RADIX_BINS) {
+        scanData[t * tileCount + tile] = digitCounts[t];
+    }
+}
+#elif defined(RADIX_SCATTER)
+layout(std430, binding = 1) readonly buffer ValuesIn { uint valuesIn[]; };
+layout(std430, binding = 2) writeonly buffer KeysOut { uint keysOut[]; };
+layout(std430, binding = 3) writeonly buffer ValuesOut { uint valuesOut[]; };
+
+// Per digit and invocation, bin-major: entry digit * LOCAL_SIZE_X + invocation
+shared uint localOffsets[RADIX_BINS * LOCAL_SIZE_X];
+shared uint digitBases[RADIX_BINS];
+
+// Moves one tile's elements to their place in the output, ranked against the scanned histogram
+void main() {
+    uint tile = tileIndex();
+    if (tile >= tileCount) {
+        return;
+    }
+    uint t = gl_LocalInvocationID.x;
+    uint first = tile * TILE_SIZE + t * ITEMS_PER_THREAD;
+
+    uint keys[ITEMS_PER_THREAD];
+    uint digitCounts[RADIX_BINS];
+    for (uint b = 0u; b < RADIX_BINS; ++b) {
+        digitCounts[b] = 0u;
+    }
+    for (uint i = 0u; i < ITEMS_PER_THREAD; ++i) {
+        if (first + i < count) {
+            keys[i] = keysIn[first + i];
+            digitCounts[digitOf(keys[i])] += 1u;
+        }
+    }
+    for (uint b = 0u; b < RADIX_BINS; ++b) {
+        localOffsets[b * LOCAL_SIZE_X + t] = digitCounts[b];
+    }
+    memoryBarrierShared();
+    barrier();
+
+    // Exclusive scan of localOffsets in bin-major order, each invocation owns RADIX_BINS consecutive entries
+    uint base = t * RADIX_BINS;
+    uint sum = 0u;
+    for (uint j = 0u; j < RADIX_BINS; ++j) {
+        sum += localOffsets[base + j];
+    }
+    uint total;
+    uint prefix = groupExclusiveScan(sum, total);
+    for (uint j = 0u; j < RADIX_BINS; ++j) {
+        uint entry = localOffsets[base + j];
+        localOffsets[base + j] = prefix;
+        prefix += entry;
+    }
+    memoryBarrierShared();
+    barrier();
+
+    // Where the tile's run of each digit starts in the output, relative to the run's start within the tile
+    if (t < RADIX_BINS) {
+        digitBases[t] = scanData[t * tileCount + tile] - localOffsets[t * LOCAL_SIZE_X];
+    }
+    memoryBarrierShared();
+    barrier();
+
+    for (uint b = 0u; b < RADIX_BINS; ++b) {
+        digitCounts[b] = digitBases[b] + localOffsets[b * LOCAL_SIZE_X + t]; // Next output slot per digit
+    }
+    for (uint i = 0u; i < ITEMS_PER_THREAD; ++i) {
+        if (first + i < count) {
+            uint digit = digitOf(keys[i]);
+            uint destination = digitCounts[digit];
+            digitCounts[digit] = destination + 1u;
+            keysOut[destination] = keys[i];
+            valuesOut[destination] = valuesIn[first + i];
+        }
+    }
+}
+#elif defined(SCAN_BLOCKS)
+// Exclusive scan of one tile of scanData in place, its total goes to blockSums
+void main() {
+    uint tile = tileIndex();
+    if (tile >= tileCount) {
+        return;
+    }
+    uint t = gl_LocalInvocationID.x;
+    uint first = tile * TILE_SIZE + t * ITEMS_PER_THREAD;
+
+    uint sum = 0u;
+    for (uint i = 0u; i < ITEMS_PER_THREAD; ++i) {
+        if (first + i < count) {
+            sum += scanData[first + i];
+        }
+    }
+    uint total;
+    uint prefix = groupExclusiveScan(sum, total);
+    for (uint i = 0u; i < ITEMS_PER_THREAD; ++i) {
+        if (first + i < count) {
+            uint entry = scanData[first + i];
+            scanData[first + i] = prefix;
+            prefix += entry;
+        }
+    }
+    if (t == 0u) {
+        blockSums[tile] = total;
+    }
+}
+#elif defined(SCAN_ADD)
+// Offsets one scanned tile by the scanned totals of the tiles before it
+void main() {
+    uint tile = tileIndex();
+    if (tile >= tileCount) {
+        return;
+    }
+    uint first = tile * TILE_SIZE + gl_LocalInvocationID.x * ITEMS_PER_THREAD;
+    uint offset = blockSums[tile];
+    for (uint i = 0u; i < ITEMS_PER_THREAD; ++i) {
+        if (first + i < count) {
+            scanData[first + i] += offset;
+        }
+    }
+}
+#endif